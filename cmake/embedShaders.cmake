@@ -0,0 +1,20 @@
+# Generate a header holding the source of every shader in SHADER_DIR as a
+# string constant named after the file, e.g. simpleVertShader.glsl becomes
+# simpleVertShaderSrc. Run as: cmake -DSHADER_DIR=... -DOUTPUT=... -P embedShaders.cmake
+
+file(GLOB shaders ${SHADER_DIR}/*.glsl)
+list(SORT shaders)
+
+set(content "// generated from shaders/*.glsl by cmake/embedShaders.cmake -- do not edit\n")
+string(APPEND content "#ifndef EMBEDDED_SHADERS_H\n#define EMBEDDED_SHADERS_H 1\n\n")
+foreach(shader ${shaders})
+  get_filename_component(name ${shader} NAME_WE)
+  file(READ ${shader} src)
+  string(APPEND content "constexpr char ${name}Src[] = R\"glsl(${src})glsl\";\n\n")
+endforeach(shader)
+string(APPEND content "#endif\n")
+
+# only touch the header when a shader changed, to avoid needless rebuilds
+file(WRITE ${OUTPUT}.tmp "${content}")
+configure_file(${OUTPUT}.tmp ${OUTPUT} COPYONLY)
+file(REMOVE ${OUTPUT}.tmp)
@@ -3,7 +3,10 @@
 #include <iostream>
 #include <string>
 #include <filesystem>
+#include <array>
 #include <stdlib.h>
+#include <thread>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -14,14 +17,38 @@
 #include "progressBar.h"
 #include "contrast.h"
 #include "utils.h"
+#include "labelWriter.h"
+#include "outputLayout.h"
+#include "options.h"
+#include "fileWriter.h"
+#include "pngEncoder.h"
+#include "rawImage.h"
+#include "renderTarget.h"
+#include "metrics.h"
+#include "trace.h"
+#include "gpuTimer.h"
+#include "embeddedShaders.h"
+#include "shaderVariants.h"
+#include "postProcess.h"
+#include "background.h"
 
 constexpr int PROGRESS_BAR_SIZE = 30;
 
+// how often window events are processed while generating
+constexpr double POLL_INTERVAL_MS = 50;
+
 const int WINDOW_WIDTH = 512;
 const int WINDOW_HEIGHT = 512;
 
+// size of the saved images, independent of the window
+const int RENDER_WIDTH = 512;
+const int RENDER_HEIGHT = 512;
+
 const std::filesystem::path TRAIN_DIR("train");
 const std::filesystem::path TEST_DIR("test");
+const std::filesystem::path LABEL_FILE("labels.bin");
+const std::filesystem::path LABEL_CSV_FILE("labels.csv");
+const std::filesystem::path BATCH_FILE("images.npy");
 
 // uint8_t WINDOW_COLOR[4] = {0xdd, 0xcc, 0xff, 0xff};
 const double INITIAL_WINDOW_COLOR[4] = {0x00/255., 0x00/255., 0x00/255., 0xff/255.};
@@ -29,9 +56,43 @@ const double INITIAL_WINDOW_COLOR[4] = {0x00/255., 0x00/255., 0x00/255., 0xff/25
 // when true, rendering begins
 bool shouldStartRendering = false;
 
-// callback to resize the framebuffer if the user resizes the window
-void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-  glViewport(0, 0, width, height);
+// run statistics, exported with --metrics
+Metrics metrics;
+Counter &framesRendered = metrics.AddCounter("frames_rendered_total", "Frames rendered.");
+Counter &bytesWritten = metrics.AddCounter("bytes_written_total", "Bytes of image data written.");
+Histogram &renderSeconds = metrics.AddHistogram("render_seconds", "CPU time to submit the draw of a frame.");
+Histogram &readbackSeconds = metrics.AddHistogram("readback_seconds", "Time to read a frame back from the GPU.");
+Histogram &encodeSeconds = metrics.AddHistogram("encode_seconds", "Time to encode a frame.");
+Gauge &writerQueueDepth = metrics.AddGauge("writer_queue_depth", "Images waiting to be written.");
+
+// optional features of the triangle shader, as bits of a variant
+enum TriangleFeature {
+  TRI_FLIP_Y = 1 << 0,    // draw upside down for top-down readback
+  TRI_GRAYSCALE = 1 << 1  // single shade instead of an RGB colour
+};
+const std::vector<std::string> TRIANGLE_FEATURES = {"FLIP_Y", "GRAYSCALE"};
+
+// stages timed on the GPU with --gpu-timers
+enum GpuStage {
+  GPU_CLEAR,
+  GPU_DRAW,
+  GPU_POST,
+  GPU_READBACK,
+  GPU_STAGES
+};
+Histogram *gpuStageSeconds[GPU_STAGES] = {
+  &metrics.AddHistogram("gpu_clear_seconds", "GPU time to clear a frame or draw its background."),
+  &metrics.AddHistogram("gpu_draw_seconds", "GPU time to draw a frame."),
+  &metrics.AddHistogram("gpu_post_seconds", "GPU time of the post-processing passes."),
+  &metrics.AddHistogram("gpu_readback_seconds", "GPU time to read back a frame.")
+};
+
+// repaint the idle window; used while waiting for SPACE, when only window
+// system events (exposure, resizing) make a redraw necessary
+void clear_window(GLFWwindow *window) {
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glfwSwapBuffers(window);
 }
 
 // respond to input
@@ -46,14 +107,167 @@ void process_input(GLFWwindow *window) {
   }
 }
 
-void save_image(GLFWwindow *window, const char *fn) {
-  int width, height;
-  glfwGetWindowSize(window, &width, &height);
-  GLubyte *pixels = new GLubyte[3*width*height];
-  glPixelStorei(GL_PACK_ALIGNMENT, 1);
-  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-  stbi_flip_vertically_on_write(true);
-  stbi_write_png(fn, width, height, 3, pixels, 3*width);
+// stb callback collecting the encoded image in memory
+void append_to_buffer(void *context, void *data, int size) {
+  std::vector<unsigned char> *buffer = (std::vector<unsigned char>*)context;
+  buffer->insert(buffer->end(), (unsigned char*)data, (unsigned char*)data + size);
+}
+
+// the sample parameters, as embedded in the image
+std::vector<PngText> sample_text(const Sample &sample) {
+  char buffer[32];
+  std::vector<PngText> text;
+  auto add = [&](const char *keyword, const char *format, auto value) {
+    std::snprintf(buffer, sizeof(buffer), format, value);
+    text.push_back(PngText{keyword, buffer});
+  };
+  add("index", "%d", sample.index);
+  add("angle", "%.9g", sample.angle);
+  add("xDisp", "%.9g", sample.xDisp);
+  add("yDisp", "%.9g", sample.yDisp);
+  add("brightness", "%.9g", sample.brightness);
+  add("contrast", "%.9g", sample.contrast);
+  add("bgShade", "%.9g", sample.bgShade);
+  if (sample.bgType) {
+    add("bgType", "%d", sample.bgType);
+    add("bgAmplitude", "%.9g", sample.bgAmplitude);
+    add("bgAngle", "%.9g", sample.bgAngle);
+    add("bgScale", "%.9g", sample.bgScale);
+    add("bgSeed", "%u", sample.bgSeed);
+    add("bgLayer", "%d", sample.bgLayer);
+    add("bgCropX", "%d", sample.bgCropX);
+    add("bgCropY", "%d", sample.bgCropY);
+  }
+  if (!sample.distractors.empty()) {
+    // x,y,radius,angle,sides,shade,front for each, separated by ';'
+    std::string distractors;
+    for (const Distractor &distractor : sample.distractors) {
+      char entry[128];
+      std::snprintf(entry, sizeof(entry), "%s%.9g,%.9g,%.9g,%.9g,%d,%.9g,%d",
+                    distractors.empty() ? "" : ";", distractor.x, distractor.y,
+                    distractor.radius, distractor.angle, distractor.sides, distractor.shade,
+                    (int)distractor.front);
+      distractors += entry;
+    }
+    text.push_back(PngText{"distractors", distractors});
+  }
+  if (sample.blurSigma > 0) {
+    add("blurSigma", "%.9g", sample.blurSigma);
+  }
+  if (sample.shotCount > 0) {
+    add("shotCount", "%.9g", sample.shotCount);
+    add("readNoise", "%.9g", sample.readNoise);
+    add("jitter", "%.9g", sample.jitter);
+    add("edgeGain", "%.9g", sample.edgeGain);
+    add("noiseSeed", "%u", sample.noiseSeed);
+  }
+  if (sample.gamma != 1 || sample.intensityOffset != 0 || sample.saturation != 1) {
+    add("gamma", "%.9g", sample.gamma);
+    add("intensityOffset", "%.9g", sample.intensityOffset);
+    add("saturation", "%.9g", sample.saturation);
+  }
+  add("seed", "%u", sample.seed);
+  return text;
+}
+
+// terminates GLFW when main returns; declared ahead of every GL object so
+// that their destructors still run with a current context, whichever path
+// main leaves by
+struct GlfwSession {
+  GlfwSession() { glfwInit(); }
+  ~GlfwSession() { glfwTerminate(); }
+};
+
+// everything one set of images (train or test) is written through
+struct OutputSet {
+  std::filesystem::path dir;
+  OutputLayout layout;
+  LabelWriter labels;
+  // only used for ImageFormat::NPY_BATCH
+  std::unique_ptr<NpyBatchWriter> batch;
+
+  OutputSet(const std::filesystem::path &dir, const Options &options, int width, int height)
+    : dir(dir), layout(dir, options.fanoutLevels),
+      labels((dir / (options.csvLabels ? LABEL_CSV_FILE : LABEL_FILE)).string(), options.distractors) {
+    if (options.format == ImageFormat::NPY_BATCH) {
+      batch = std::make_unique<NpyBatchWriter>((dir / BATCH_FILE).string(), width, height,
+                                               options.channels);
+    }
+  }
+  // number of images that could not be written to the batch file
+  size_t Errors() const {
+    return batch ? batch->Errors() : 0;
+  }
+  void Close() {
+    labels.Close();
+    layout.Close();
+    if (batch) {
+      batch->Close();
+    }
+  }
+};
+
+// read back the frame, write it out in the requested format as baseName
+// within the set, and record its labels; returns the bytes written
+size_t save_image(RenderTarget &target, const Options &options, FileWriter &writer,
+                OutputSet &set, Sample &sample, const std::string &baseName,
+                GpuTimer *gpuTimer) {
+  const int width = target.Width();
+  const int height = target.Height();
+  std::vector<GLubyte> pixels;
+  {
+    TRACE_SCOPE("readback");
+    ScopedTimer timer(readbackSeconds);
+    if (gpuTimer) {
+      gpuTimer->Begin(GPU_READBACK);
+    }
+    // frames are drawn upside down, so this gives rows top-down
+    target.ReadPixels(pixels);
+    if (gpuTimer) {
+      gpuTimer->End();
+    }
+  }
+
+  if (set.batch) {
+    // the row of the array is the sample's index within the set
+    TRACE_SCOPE("write_batch");
+    if (set.batch->Append(pixels.data(), 3*width) < 0) {
+      return 0;
+    }
+    sample.path = BATCH_FILE.string();
+    set.labels.Append(sample);
+    bytesWritten.Inc((size_t)options.channels*width*height);
+    return (size_t)options.channels*width*height;
+  }
+
+  sample.path = set.layout.Place(baseName + formatExtension(options.format)).string();
+
+  // encode in memory and let the writer do the file I/O
+  std::vector<unsigned char> file;
+  {
+    TRACE_SCOPE("encode");
+    ScopedTimer encodeTimer(encodeSeconds);
+    if (options.format == ImageFormat::PNG) {
+      // flat frames take the fast palette encoder, anything else goes through stb
+      const std::vector<PngText> text = sample_text(sample);
+      if (!encodePalettePng(file, pixels.data(), width, height, 3*width, text)) {
+        stbi_write_png_to_func(append_to_buffer, &file, width, height, 3, pixels.data(), 3*width);
+        insertPngText(file, text);
+      }
+    } else {
+      encodeRawImage(file, options.format, pixels.data(), width, height, 3*width,
+                     options.channels);
+    }
+  }
+  const size_t bytes = file.size();
+  bytesWritten.Inc(bytes);
+  {
+    TRACE_SCOPE("submit");
+    writer.Submit((set.dir / sample.path).string(), std::move(file));
+  }
+  writerQueueDepth.Set(writer.Pending());
+  set.labels.Append(sample);
+  return bytes;
 }
 
 #define glClearColorArray(color) \
@@ -62,11 +276,197 @@ void save_image(GLFWwindow *window, const char *fn) {
 #define glClearColorByteArray(color) \
   glClearColor(color[0] / 255., color[1] / 255., color[2] / 255., color[3] / 255.)
 
-// generate xDisp and yDisp
+constexpr float maxContrast = 1;
+constexpr float minContrast = 0.9;
+constexpr float maxBrightness = 1;
+constexpr float minBrightness = 0.75;
+
+// ranges of the patterned backgrounds
+constexpr float minBgAmplitude = 0.05;
+constexpr float maxBgAmplitude = 0.2;
+constexpr float minBgImageAmplitude = 0.2;
+constexpr float maxBgImageAmplitude = 0.5;
+constexpr float minBgScale = 16;  // pixels
+constexpr float maxBgScale = 128;
+
+// ranges of the distractor polygons used with --distractors
+constexpr int minDistractorSides = 3;
+constexpr int maxDistractorSides = 6;
+constexpr float minDistractorRadius = 0.03;  // clip-space units
+constexpr float maxDistractorRadius = 0.15;
+constexpr float minDistractorShade = 0.1;
+constexpr float maxDistractorShade = 1;
+
+// range of the blur sigma used with --blur, in pixels
+constexpr float minBlurSigma = 0.5;
+constexpr float maxBlurSigma = 2.5;
+
+// ranges of the SEM detector model used with --noise
+constexpr float minShotCount = 20;  // electrons per unit of intensity
+constexpr float maxShotCount = 200;
+constexpr float maxReadNoise = 0.03;
+constexpr float maxJitter = 0.75;   // pixels
+constexpr float maxEdgeGain = 0.5;
+
+// ranges of the detector response used with --transfer
+constexpr float minGamma = 0.7;
+constexpr float maxGamma = 1.4;
+constexpr float maxIntensityOffset = 0.05;
+constexpr float minSaturation = 0.8;
+constexpr float maxSaturation = 1;
+
+// the triangle's rotation by angle degrees as a column-major matrix, from
+// the lookup table so that no trig runs per sample
+void rotation_matrix(float angle, float out[4]) {
+  float s, c;
+  sinCosDegrees(angle, s, c);
+  out[0] = c;
+  out[1] = -s;
+  out[2] = s;
+  out[3] = c;
+}
+
+// pick the random parameters of a sample at the given angle and draw it
+// into the target
+void render_sample(RenderTarget &target, Shader &shader, Background &background,
+                   Triangle &triangle, const Options &options, Sample &sample,
+                   GpuTimer *gpuTimer) {
+  TRACE_SCOPE("render");
+  ScopedTimer timer(renderSeconds);
+  target.Bind();
+
+  // generate the displacements
+  triangle.GenerateDisplacements(sample.angle, sample.xDisp, sample.yDisp);
+
+  // generate a random brightness/contrast
+  sample.brightness = randFloat(minBrightness, maxBrightness);
+  sample.contrast = randFloat(minContrast, maxContrast);
+  // set the background
+  sample.bgShade = findBg(sample.brightness, sample.contrast);
+  BackgroundType bgType = options.background;
+  if (bgType == BackgroundType::MIXED) {
+    // images only join the mix when a library was loaded
+    bgType = (BackgroundType)(rand() % (background.Library() ? 4 : 3));
+  }
+  sample.bgType = (int)bgType;
+  if (bgType == BackgroundType::IMAGE) {
+    const BackgroundLibrary &library = *background.Library();
+    sample.bgAmplitude = randFloat(minBgImageAmplitude, maxBgImageAmplitude);
+    sample.bgLayer = library.Layer(rand() % library.Size());
+    // where a frame-sized window fits in the image
+    const int spareX = library.Width(sample.bgLayer) - target.Width();
+    const int spareY = library.Height(sample.bgLayer) - target.Height();
+    sample.bgCropX = spareX > 0 ? rand() % (spareX + 1) : 0;
+    sample.bgCropY = spareY > 0 ? rand() % (spareY + 1) : 0;
+  } else if (bgType != BackgroundType::FLAT) {
+    sample.bgAmplitude = randFloat(minBgAmplitude, maxBgAmplitude);
+    if (bgType == BackgroundType::GRADIENT) {
+      sample.bgAngle = randFloat(0, 360);
+    } else {
+      sample.bgScale = randFloat(minBgScale, maxBgScale);
+      sample.bgSeed = rand();
+    }
+  }
+
+  // debris, anywhere in the frame and in front of or behind the triangle
+  for (int i = 0; i < options.distractors; ++i) {
+    Distractor distractor;
+    distractor.x = randFloat(-1, 1);
+    distractor.y = randFloat(-1, 1);
+    distractor.radius = randFloat(minDistractorRadius, maxDistractorRadius);
+    distractor.angle = randFloat(0, 360);
+    distractor.sides = minDistractorSides + rand() % (maxDistractorSides - minDistractorSides + 1);
+    distractor.shade = randFloat(minDistractorShade, maxDistractorShade);
+    distractor.front = rand() % 2;
+    sample.distractors.push_back(distractor);
+  }
+
+  if (gpuTimer) {
+    gpuTimer->Begin(GPU_CLEAR);
+  }
+  background.Draw(sample);
+  if (gpuTimer) {
+    gpuTimer->Begin(GPU_DRAW);
+  }
+
+  // use our shader to draw our vertices as a triangle
+  shader.use();
+  // shader.setFloat("triShade", 0.85f);
+  shader.setFloat("triShade", sample.brightness);
+  float rotation[4];
+  rotation_matrix(sample.angle, rotation);
+  shader.set2Mat("rotation", rotation);
+  shader.setFloat("xDisp", sample.xDisp);
+  shader.setFloat("yDisp", sample.yDisp);
+  triangle.Draw(sample.distractors);
+  if (gpuTimer) {
+    gpuTimer->End();
+  }
+  framesRendered.Inc();
+}
+
+// pick the post-processing parameters of a sample and run the enabled
+// passes; returns the target holding the finished frame
+RenderTarget &post_process(PostProcess &post, RenderTarget &frame, const Options &options,
+                           Sample &sample, GpuTimer *gpuTimer) {
+  if (options.blur) {
+    sample.blurSigma = randFloat(minBlurSigma, maxBlurSigma);
+  }
+  if (options.noise) {
+    sample.shotCount = randFloat(minShotCount, maxShotCount);
+    sample.readNoise = randFloat(0, maxReadNoise);
+    sample.jitter = randFloat(0, maxJitter);
+    sample.edgeGain = randFloat(0, maxEdgeGain);
+    sample.noiseSeed = rand();
+  }
+  if (options.transfer) {
+    sample.gamma = randFloat(minGamma, maxGamma);
+    sample.intensityOffset = randFloat(-maxIntensityOffset, maxIntensityOffset);
+    sample.saturation = randFloat(minSaturation, maxSaturation);
+  }
+
+  TRACE_SCOPE("post");
+  if (gpuTimer) {
+    gpuTimer->Begin(GPU_POST);
+  }
+  RenderTarget &result = post.Apply(frame, sample);
+  if (gpuTimer) {
+    gpuTimer->End();
+  }
+  return result;
+}
+
+// show the latest frame in the window
+void preview(GLFWwindow *window, RenderTarget &target) {
+  TRACE_SCOPE("preview");
+  int width, height;
+  glfwGetFramebufferSize(window, &width, &height);
+  // undo the flip frames are drawn with
+  target.BlitToWindow(width, height, true);
+  glfwSwapBuffers(window);
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  switch (parseOptions(argc, argv, options)) {
+  case ParseResult::RUN:
+    break;
+  case ParseResult::EXIT:
+    return 0;
+  case ParseResult::ERROR:
+    return 1;
+  }
+  srand(options.seed);
+  if (!options.tracePath.empty()) {
+#ifdef ENABLE_TRACING
+    Tracer::Get().Enable(options.tracePath);
+#else
+    std::cerr << "--trace ignored: built without ENABLE_TRACING" << std::endl;
+#endif
+  }
 
-int main() {
   /* initialise a GLFW window (LearnOpenGL 4) */
-  glfwInit();
+  GlfwSession glfw;
 
   // set required OpenGL version and profile
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -77,23 +477,23 @@ int main() {
   GLFWwindow *window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "LearnOpenGL", NULL, NULL);
   if (!window) {
     std::cerr << "Failed to create GLFW window!" << std::endl;
-    glfwTerminate();
     return -1;
   }
   glfwMakeContextCurrent(window);
+  // never let vsync pace generation
+  glfwSwapInterval(0);
 
   /* initialise GLAD so we can access OpenGL function pointers (LearnOpenGL 4.1) */
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
     std::cerr << "Failed to initialise GLAD!" << std::endl;
-    glfwTerminate();
     return -1;
   }
 
-  /* set viewport size */
-  glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-
-  /* register callback */
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+  /* offscreen target the images are rendered into */
+  RenderTarget target(RENDER_WIDTH, RENDER_HEIGHT);
+  if (!target.Complete()) {
+    return -1;
+  }
 
   /* construct vertices for a scalene triangle -- this has no
      rotational symmetry*/
@@ -106,8 +506,38 @@ int main() {
   // construct Triangle object
   Triangle scalene(vertices);
 
-  // build the shader program
-  Shader simpleShader("./shaders/simpleVertShader.glsl", "./shaders/simpleFragShader.glsl");
+  // build the shader program, reusing a cached binary when possible
+  if (!options.shaderCacheDir.empty()) {
+    Shader::enableBinaryCache(options.shaderCacheDir, (GLADloadproc)glfwGetProcAddress);
+  }
+  ShaderVariants triangleShaders(simpleVertShaderSrc, simpleFragShaderSrc, TRIANGLE_FEATURES, "simple");
+  // the smallest program that covers this job: flipped for readback, and
+  // grey as the triangle only has a shade
+  Shader &simpleShader = triangleShaders.Get(TRI_FLIP_Y | TRI_GRAYSCALE);
+
+  // pattern drawn behind the triangle
+  Background background(RENDER_WIDTH, RENDER_HEIGHT);
+  std::unique_ptr<BackgroundLibrary> library;
+  if (!options.backgroundDir.empty()) {
+    std::cerr << "loading background images..." << std::endl;
+    library = std::make_unique<BackgroundLibrary>(options.backgroundDir,
+                                                  std::max(1u, std::thread::hardware_concurrency()));
+    if (!library->Size()) {
+      std::cerr << "no usable images in '" << options.backgroundDir << "'" << std::endl;
+      return -1;
+    }
+    std::cerr << library->Size() << " background images loaded." << std::endl;
+    background.SetLibrary(library.get());
+  }
+
+  // passes run over each frame before it is saved
+  PostProcess post(RENDER_WIDTH, RENDER_HEIGHT);
+  if (!post.Complete()) {
+    return -1;
+  }
+  post.EnableBlur(options.blur);
+  post.EnableDetector(options.noise);
+  post.EnableTransfer(options.transfer);
 
   glClearColorArray(INITIAL_WINDOW_COLOR);
 
@@ -116,11 +546,14 @@ int main() {
   constexpr int numrots = 36*2;
   constexpr int numPerRot = 10;
   constexpr float step = (maxrot - minrot)/(numrots - 1);
-
-  constexpr float maxContrast = 1;
-  constexpr float minContrast = 0.9;
-  constexpr float maxBrightness = 1;
-  constexpr float minBrightness = 0.75;
+  // the sweep is fixed, so its angles are worked out at compile time
+  constexpr std::array<float, numrots> trainAngles = [] {
+    std::array<float, numrots> angles{};
+    for (int i = 0; i < numrots; ++i) {
+      angles[i] = minrot + step*i;
+    }
+    return angles;
+  }();
 
   std::cerr << "creating output directories..." << std::endl;
   // try to create train and test directories
@@ -147,116 +580,140 @@ int main() {
     }
   }  std::cerr << "done." << std::endl;
   
-  // wait in a basic loop
+  // wait for SPACE, sleeping until there are events rather than spinning:
+  // with vsync off, nothing else would throttle the loop
+  clear_window(window);
+  glfwSetWindowRefreshCallback(window, clear_window);
   while (!glfwWindowShouldClose(window) && !shouldStartRendering) {
+    glfwWaitEventsTimeout(POLL_INTERVAL_MS / 1000.);
     process_input(window);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glfwSwapBuffers(window);
-    glfwPollEvents();
   }
+  glfwSetWindowRefreshCallback(window, nullptr);
   if (glfwWindowShouldClose(window)) {
     return 0;
   }
 
+  std::unique_ptr<FileWriter> writer = FileWriter::Create(options.writerBackend, options.writerThreads);
+
+  if (!options.metricsPath.empty()) {
+    metrics.Start(options.metricsPath, options.metricsIntervalMs);
+  }
+
+  // per-stage GPU timing
+  std::unique_ptr<GpuTimer> gpuTimer;
+  if (options.gpuTimers) {
+    gpuTimer = std::make_unique<GpuTimer>(std::vector<std::string>{"clear", "draw", "post", "readback"});
+    for (int stage = 0; stage < GPU_STAGES; ++stage) {
+      gpuTimer->SetHistogram(stage, gpuStageSeconds[stage]);
+    }
+  }
+
+  // the preview and event handling run on timers rather than every frame
+  RateLimiter previewTimer(options.previewIntervalMs);
+  RateLimiter pollTimer(POLL_INTERVAL_MS);
+
   // generate training data
   std::cerr << "Generating training data...";
+  OutputSet trainSet(TRAIN_DIR, options, RENDER_WIDTH, RENDER_HEIGHT);
   ProgressBar trainBar(PROGRESS_BAR_SIZE, 0, numrots*numPerRot, true);
+  trainBar.SetMode(options.progressMode, "train");
+  trainBar.SetInterval(options.progressIntervalMs);
+  trainBar.Start();
   for (int i = 0; i < numrots; ++i) {
     // check for premature exit
     if (glfwWindowShouldClose(window)) {
       return 0;
     }
     
-    float angle = (minrot + step*i);
+    const float angle = trainAngles[i];
 
     // generate multiple images for each angle
     for (int j = 0; j < numPerRot; ++j) {
-      // generate the displacements
-      float xDisp;
-      float yDisp;
-      scalene.GenerateDisplacements(xDisp, yDisp);
-
-      // generate a random brightness/contrast
-      float brightness = randFloat(minBrightness, maxBrightness);
-      float contrast = randFloat(minContrast, maxContrast);
-      // set the background
-      float bgShade = findBg(brightness, contrast);
-      float bgColour[4] = {bgShade, bgShade, bgShade, 1.0};
-      glClearColorArray(bgColour);
-
-      glClear(GL_COLOR_BUFFER_BIT);
-
-      // use our shader to draw our vertices as a triangle
-      simpleShader.use();
-      // simpleShader.set3Vec("triColor", 0.85f, 0.85f, 0.85f);
-      simpleShader.set3Vec("triColor", brightness, brightness, brightness);
-      simpleShader.setFloat("theta", angle * M_PI / 180.);
-      simpleShader.setFloat("xDisp", xDisp);
-      simpleShader.setFloat("yDisp", yDisp);
-      scalene.Draw();
+      TRACE_SCOPE("sample");
+      Sample sample;
+      sample.index = i*numPerRot + j;
+      sample.seed = options.seed;
+      sample.angle = angle;
+      render_sample(target, simpleShader, background, scalene, options, sample, gpuTimer.get());
+      RenderTarget &frame = post_process(post, target, options, sample, gpuTimer.get());
 
       char buffer[128];
       std::snprintf(buffer, 128, "%02d_%06.2f", j, angle);
-      std::string fileName(buffer);
-      fileName = fileName + ".png";
-      save_image(window, (TRAIN_DIR / fileName).c_str());
-
-      glfwSwapBuffers(window);
-      glfwPollEvents();
+      trainBar.AddBytes(save_image(frame, options, *writer, trainSet, sample, buffer,
+                                      gpuTimer.get()));
+      if (gpuTimer) {
+        gpuTimer->NextFrame();
+      }
+
+      if (options.preview && previewTimer.Ready()) {
+        preview(window, frame);
+      }
+      if (pollTimer.Ready()) {
+        glfwPollEvents();
+      }
       ++trainBar;
-      trainBar.Display();
     }
   }
-  std::cerr << std::endl;
+  trainSet.Close();
+  trainBar.Finish();
+  size_t batchErrors = trainSet.Errors();
 
   // generate test data
   constexpr int numtests = 5000;
   std::cerr << "Generating test data...";
+  OutputSet testSet(TEST_DIR, options, RENDER_WIDTH, RENDER_HEIGHT);
   ProgressBar testBar(PROGRESS_BAR_SIZE, 0, numtests, true);
+  testBar.SetMode(options.progressMode, "test");
+  testBar.SetInterval(options.progressIntervalMs);
+  testBar.Start();
   for (int i = 0; i < numtests; ++i) {
     // check for premature exit
     if (glfwWindowShouldClose(window)) {
       return 0;
     }
 
-    float angle = (rand() % 36000) / 100.;
-    // generate the displacements
-    float xDisp;
-    float yDisp;
-    scalene.GenerateDisplacements(xDisp, yDisp);
-
-    // generate a random brightness/contrast
-    float brightness = randFloat(minBrightness, maxBrightness);
-    float contrast = randFloat(minContrast, maxContrast);
-    // set the background
-    float bgShade = findBg(brightness, contrast);
-    float bgColour[4] = {bgShade, bgShade, bgShade, 1.0};
-    glClearColorArray(bgColour);
-    
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    // use our shader to draw our vertices as a triangle
-    simpleShader.use();
-    // simpleShader.set3Vec("triColor", 0.85f, 0.85f, 0.85f);
-    simpleShader.set3Vec("triColor", brightness, brightness, brightness);
-    simpleShader.setFloat("theta", angle * M_PI/180.);
-    simpleShader.setFloat("xDisp", xDisp);
-    simpleShader.setFloat("yDisp", yDisp);
-    scalene.Draw();
+    TRACE_SCOPE("sample");
+    Sample sample;
+    sample.index = i;
+    sample.seed = options.seed;
+    sample.angle = (rand() % 36000) / 100.;
+    render_sample(target, simpleShader, background, scalene, options, sample, gpuTimer.get());
+    RenderTarget &frame = post_process(post, target, options, sample, gpuTimer.get());
 
     char buffer[128];
-    std::snprintf(buffer, 128, "%04d_%06.2f", i, angle);
-    std::string fileName(buffer);
-    fileName = fileName + ".png";
-    save_image(window, (TEST_DIR / fileName).c_str());
+    std::snprintf(buffer, 128, "%04d_%06.2f", i, sample.angle);
+    testBar.AddBytes(save_image(frame, options, *writer, testSet, sample, buffer,
+                                    gpuTimer.get()));
+    if (gpuTimer) {
+      gpuTimer->NextFrame();
+    }
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    if (options.preview && previewTimer.Ready()) {
+      preview(window, frame);
+    }
+    if (pollTimer.Ready()) {
+      glfwPollEvents();
+    }
     ++testBar;
-    testBar.Display();
   }
-
-  glfwTerminate();
-  std::cerr << std::endl;
+  testSet.Close();
+  batchErrors += testSet.Errors();
+
+  writer->Flush();
+  testBar.Finish();
+  if (gpuTimer) {
+    gpuTimer->Flush();
+    gpuTimer->Report(std::cerr);
+    gpuTimer->Destroy();
+  }
+  metrics.Stop();
+#ifdef ENABLE_TRACING
+  Tracer::Get().Dump();
+#endif
+  const size_t errors = writer->Errors() + batchErrors;
+  if (errors) {
+    std::cerr << errors << " images could not be written" << std::endl;
+    return 1;
+  }
   return 0;
 }
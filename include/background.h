@@ -0,0 +1,43 @@
+// -*- mode: C++; -*-
+#ifndef BACKGROUND_H
+#define BACKGROUND_H 1
+
+#include <glad/glad.h>
+
+#include "backgroundLibrary.h"
+#include "labelWriter.h"
+#include "shaderVariants.h"
+
+// kinds of background behind the triangle; MIXED picks one per sample
+enum class BackgroundType {
+  FLAT = 0,
+  GRADIENT = 1,
+  NOISE = 2,
+  IMAGE = 3,
+  MIXED
+};
+
+// Fills the bound target with a sample's background: a plain clear to
+// bgShade, or a full-screen pass adding a linear gradient or fractal value
+// noise of bgAmplitude on top of it, or a crop of a library image scaled
+// the same way.
+class Background {
+public:
+  Background(int width, int height);
+  ~Background() { Destroy(); }
+  // free the GL objects; must happen while the context is still current
+  void Destroy();
+  // images for BackgroundType::IMAGE
+  void SetLibrary(const BackgroundLibrary *library) { fLibrary = library; }
+  const BackgroundLibrary *Library() const { return fLibrary; }
+  void Draw(const Sample &sample);
+
+private:
+  ShaderVariants fShaders;
+  const BackgroundLibrary *fLibrary;
+  GLuint fVAO;
+  int fWidth;
+  int fHeight;
+};
+
+#endif
@@ -0,0 +1,46 @@
+// -*- mode: C++; -*-
+#ifndef BACKGROUND_LIBRARY_H
+#define BACKGROUND_LIBRARY_H 1
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+// decoded images waiting to be uploaded, per decoding thread
+#ifndef BACKGROUND_QUEUE_PER_THREAD
+#define BACKGROUND_QUEUE_PER_THREAD 2
+#endif
+
+// Real background images, decoded once at startup and kept on the GPU as
+// the layers of one greyscale texture array, so samples can use them with
+// no disk I/O or decoding. Files are taken in name order, which keeps the
+// layer of an image the same between runs. Layers are as large as the
+// largest image; smaller images fill the corner at texel (0, 0).
+class BackgroundLibrary {
+public:
+  // decode every image in dir on the given number of threads
+  BackgroundLibrary(const std::string &dir, int threads);
+  ~BackgroundLibrary() { Destroy(); }
+  // free the GL objects; must happen while the context is still current
+  void Destroy();
+  // number of images that loaded
+  int Size() const { return fLoaded.size(); }
+  // layer holding the i-th image that loaded
+  int Layer(int i) const { return fLoaded[i]; }
+  // size of the image in a layer, 0 if it failed to load
+  int Width(int layer) const { return fExtents[layer].width; }
+  int Height(int layer) const { return fExtents[layer].height; }
+  GLuint Texture() const { return fTexture; }
+
+private:
+  struct Extent {
+    int width;
+    int height;
+  };
+
+  GLuint fTexture;
+  std::vector<Extent> fExtents;
+  std::vector<int> fLoaded;
+};
+
+#endif
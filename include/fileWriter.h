@@ -0,0 +1,42 @@
+// -*- mode: C++; -*-
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H 1
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef FILE_WRITER_BATCH
+#define FILE_WRITER_BATCH 64
+#endif
+
+#ifndef FILE_WRITER_QUEUE_DEPTH
+#define FILE_WRITER_QUEUE_DEPTH 256
+#endif
+
+enum class WriterBackend {
+  SYNC,    // open/write/close on the calling thread
+  THREADS, // pool of threads doing open/write/close
+  URING    // batched, linked open/write/close chains through io_uring
+};
+
+// Writes fully-encoded files to disk, possibly asynchronously. Submitted
+// buffers are owned by the writer until they have been written.
+class FileWriter {
+public:
+  virtual ~FileWriter() {}
+  // queue data to be written to path, replacing any existing file
+  virtual void Submit(const std::string &path, std::vector<unsigned char> &&data) = 0;
+  // block until every submitted file has been written
+  virtual void Flush() = 0;
+  // number of files that could not be written
+  virtual size_t Errors() const = 0;
+  // number of submitted files not yet written; safe to call from any thread
+  virtual size_t Pending() const = 0;
+
+  // construct a writer, falling back to the thread pool if io_uring is
+  // not available
+  static std::unique_ptr<FileWriter> Create(WriterBackend backend, int threads);
+};
+
+#endif
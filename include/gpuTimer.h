@@ -0,0 +1,55 @@
+// -*- mode: C++; -*-
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H 1
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+#include "metrics.h"
+
+// frames a query result is left before being read, so reading never stalls
+#ifndef GPU_TIMER_LATENCY
+#define GPU_TIMER_LATENCY 4
+#endif
+
+// Measures how long the GPU spends on each stage of a frame using
+// GL_TIME_ELAPSED queries. Queries come from a pool of GPU_TIMER_LATENCY
+// frames and are read back when their frame is reused, by which time the
+// results are ready. Stages must not overlap, as GL allows only one active
+// time query.
+class GpuTimer {
+public:
+  GpuTimer(const std::vector<std::string> &stages, int latency=GPU_TIMER_LATENCY);
+  ~GpuTimer() { Destroy(); }
+  // free the queries; must happen while the context is still current
+  void Destroy();
+  // report each measurement of a stage to a histogram as well
+  void SetHistogram(int stage, Histogram *histogram) { fHistograms[stage] = histogram; }
+  // start timing a stage, ending the previous one if still running
+  void Begin(int stage);
+  void End();
+  // finish the current frame and collect the frame being reused
+  void NextFrame();
+  // collect every outstanding result
+  void Flush();
+  // average GPU time of each stage
+  void Report(std::ostream &out) const;
+
+private:
+  void Collect(int frame);
+
+  std::vector<std::string> fStages;
+  std::vector<GLuint> fQueries;
+  // whether each query of each frame was issued
+  std::vector<bool> fIssued;
+  std::vector<Histogram*> fHistograms;
+  std::vector<double> fTotals;
+  std::vector<uint64_t> fCounts;
+  int fLatency;
+  int fFrame;
+  int fActive;
+};
+
+#endif
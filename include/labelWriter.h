@@ -0,0 +1,120 @@
+// -*- mode: C++; -*-
+#ifndef LABEL_WRITER_H
+#define LABEL_WRITER_H 1
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef LABEL_BLOCK_ROWS
+#define LABEL_BLOCK_ROWS 4096
+#endif
+
+// a regular polygon drawn as debris around the triangle, in the same
+// clip-space coordinates as the displacements
+struct Distractor {
+  float x;
+  float y;
+  // distance from the centre to the corners
+  float radius;
+  // rotation of the first corner from the x axis, in degrees
+  float angle;
+  int sides;
+  float shade;
+  // drawn over the triangle rather than under it
+  bool front;
+};
+
+// the parameters a single image was rendered with
+struct Sample {
+  int index;
+  float angle;
+  float xDisp;
+  float yDisp;
+  float brightness;
+  float contrast;
+  float bgShade;
+  // background pattern (a BackgroundType) added on top of bgShade; all
+  // zero for a flat background
+  int bgType = 0;
+  float bgAmplitude = 0;
+  // direction of a gradient, in degrees
+  float bgAngle = 0;
+  // size of the coarsest noise cells, in pixels
+  float bgScale = 0;
+  unsigned bgSeed = 0;
+  // library image and the corner of the part of it used, in pixels
+  int bgLayer = 0;
+  int bgCropX = 0;
+  int bgCropY = 0;
+  // Gaussian blur of the beam spot in pixels, zero unless --blur is given
+  float blurSigma = 0;
+  // SEM detector model, all zero unless --noise is given
+  float shotCount = 0;
+  float readNoise = 0;
+  float jitter = 0;
+  float edgeGain = 0;
+  unsigned noiseSeed = 0;
+  // detector response, out = (in^gamma + intensityOffset) / saturation;
+  // the identity unless --transfer is given
+  float gamma = 1;
+  float intensityOffset = 0;
+  float saturation = 1;
+  std::vector<Distractor> distractors;
+  // seed of the run that produced the sample
+  unsigned seed;
+  std::string path;
+};
+
+enum class LabelType : uint8_t {
+  INT32 = 0,
+  FLOAT32 = 1,
+  STRING = 2
+};
+
+// Appends one record per sample to a label sidecar. Paths ending in ".csv"
+// get a plain CSV file; anything else gets the binary columnar format:
+//
+//   header: "RLBL" | u32 version | u32 numColumns | numColumns * (u8 type, u8 nameLen, name)
+//   blocks: u32 numRows | each column in turn as a contiguous array
+//
+// STRING columns are stored as (numRows+1) u32 offsets followed by the bytes.
+//
+// Each of the distractors gets its own group of columns, named
+// distractor<i>X, distractor<i>Y and so on.
+class LabelWriter {
+public:
+  LabelWriter(const std::string &path, int distractors=0, int blockRows=LABEL_BLOCK_ROWS);
+  ~LabelWriter() { Close(); }
+  void Append(const Sample &sample);
+  void Close();
+
+private:
+  struct Column {
+    std::string name;
+    LabelType type;
+    std::vector<char> data;
+    std::vector<uint32_t> offsets;
+  };
+
+  void AddColumn(const std::string &name, LabelType type);
+  void PushInt(int column, int32_t value);
+  void PushFloat(int column, float value);
+  // a numeric column of either type
+  void PushValue(int column, LabelType type, double value);
+  void PushString(int column, const std::string &value);
+  void WriteHeader();
+  void FlushBlock();
+
+  std::ofstream fFile;
+  std::vector<Column> fColumns;
+  std::string fCsvBuffer;
+  int fDistractors;
+  int fBlockRows;
+  int fRows;
+  bool fCsv;
+  bool fOpen;
+};
+
+#endif
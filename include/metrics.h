@@ -0,0 +1,117 @@
+// -*- mode: C++; -*-
+#ifndef METRICS_H
+#define METRICS_H 1
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifndef METRICS_INTERVAL_MS
+#define METRICS_INTERVAL_MS 5000
+#endif
+
+// histogram buckets are powers of two times the smallest bound
+#ifndef METRICS_BUCKETS
+#define METRICS_BUCKETS 16
+#endif
+#ifndef METRICS_MIN_BUCKET_S
+#define METRICS_MIN_BUCKET_S 25e-6
+#endif
+
+class Counter {
+public:
+  void Inc(uint64_t amount=1) { fValue.fetch_add(amount, std::memory_order_relaxed); }
+  uint64_t Value() const { return fValue.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> fValue{0};
+};
+
+class Gauge {
+public:
+  void Set(double value) { fValue.store(value, std::memory_order_relaxed); }
+  double Value() const { return fValue.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<double> fValue{0};
+};
+
+// distribution of durations in seconds
+class Histogram {
+public:
+  void Observe(double seconds);
+  double Bound(int bucket) const;
+  uint64_t BucketCount(int bucket) const { return fBuckets[bucket].load(std::memory_order_relaxed); }
+  uint64_t Count() const { return fCount.load(std::memory_order_relaxed); }
+  double Sum() const { return fSumNs.load(std::memory_order_relaxed) * 1e-9; }
+
+private:
+  std::atomic<uint64_t> fBuckets[METRICS_BUCKETS] = {};
+  std::atomic<uint64_t> fCount{0};
+  std::atomic<uint64_t> fSumNs{0};
+};
+
+// observes the lifetime of the scope into a histogram
+class ScopedTimer {
+public:
+  ScopedTimer(Histogram &histogram)
+    : fHistogram(histogram), fStart(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    fHistogram.Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - fStart).count());
+  }
+
+private:
+  Histogram &fHistogram;
+  std::chrono::steady_clock::time_point fStart;
+};
+
+// A registry of counters, gauges and histograms which a background thread
+// periodically writes to a file in the Prometheus text exposition format,
+// e.g. for node_exporter's textfile collector. The file is replaced
+// atomically, so readers never see a partial write. Metrics must all be
+// added before Start().
+class Metrics {
+public:
+  Metrics(const std::string &prefix="rotgen");
+  ~Metrics() { Stop(); }
+  Counter &AddCounter(const std::string &name, const std::string &help);
+  Histogram &AddHistogram(const std::string &name, const std::string &help);
+  Gauge &AddGauge(const std::string &name, const std::string &help);
+
+  // write to path every interval until Stop()
+  void Start(const std::string &path, double intervalMs=METRICS_INTERVAL_MS);
+  // stop the writer thread after a final write
+  void Stop();
+  std::string Format() const;
+
+private:
+  struct Entry {
+    std::string name;
+    std::string help;
+    Counter *counter;
+    Gauge *gauge;
+    Histogram *histogram;
+  };
+  void Run();
+  void Write();
+
+  std::string fPrefix;
+  std::deque<Counter> fCounters;
+  std::deque<Gauge> fGauges;
+  std::deque<Histogram> fHistograms;
+  std::deque<Entry> fEntries;
+
+  std::string fPath;
+  double fIntervalMs;
+  std::thread fThread;
+  std::mutex fMutex;
+  std::condition_variable fWake;
+  bool fStopping;
+};
+
+#endif
@@ -0,0 +1,71 @@
+// -*- mode: C++; -*-
+#ifndef OPTIONS_H
+#define OPTIONS_H 1
+
+#include <string>
+
+#include "fileWriter.h"
+#include "rawImage.h"
+#include "progressBar.h"
+#include "metrics.h"
+#include "background.h"
+
+// per-user location for cached shader binaries
+std::string defaultShaderCacheDir();
+
+// run-time configuration, set from the command line
+struct Options {
+  // number of hashed directory levels below train/ and test/
+  int fanoutLevels = 0;
+  // seed for rand(); 1 matches an unseeded run
+  unsigned seed = 1;
+  // image file format, and channels for the NumPy formats (1 or 3)
+  ImageFormat format = ImageFormat::PNG;
+  int channels = 1;
+  // show frames in the window, at most once per interval
+  bool preview = true;
+  double previewIntervalMs = 100;
+  // progress output and how often it is redrawn
+  ProgressMode progressMode = ProgressMode::BAR;
+  double progressIntervalMs = PROGRESS_INTERVAL_MS;
+  // Prometheus text file metrics are written to, if any, and how often
+  std::string metricsPath;
+  double metricsIntervalMs = METRICS_INTERVAL_MS;
+  // where linked shader programs are cached; empty to disable
+  std::string shaderCacheDir = defaultShaderCacheDir();
+  // pattern drawn behind the triangle
+  BackgroundType background = BackgroundType::FLAT;
+  // directory of images for BackgroundType::IMAGE
+  std::string backgroundDir;
+  // random gamma, offset and saturation of the detector response
+  bool transfer = false;
+  // random polygons drawn as debris around the triangle in each frame
+  int distractors = 0;
+  // blur each frame with a random beam spot size
+  bool blur = false;
+  // apply the SEM detector model (noise, scan jitter, edge effect)
+  bool noise = false;
+  // write the label sidecar as CSV rather than the binary columnar format
+  bool csvLabels = false;
+  // time the clear, draw and readback of each frame on the GPU
+  bool gpuTimers = false;
+  // Chrome trace JSON output, when built with ENABLE_TRACING
+  std::string tracePath;
+  // how encoded images get to disk
+  WriterBackend writerBackend = WriterBackend::URING;
+  int writerThreads = 4;
+};
+
+// what main should do after parsing the command line
+enum class ParseResult {
+  RUN,
+  // --help was given; exit successfully
+  EXIT,
+  // the command line was invalid; exit with an error
+  ERROR
+};
+
+// parse argv into options
+ParseResult parseOptions(int argc, char **argv, Options &options);
+
+#endif
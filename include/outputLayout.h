@@ -0,0 +1,33 @@
+// -*- mode: C++; -*-
+#ifndef OUTPUT_LAYOUT_H
+#define OUTPUT_LAYOUT_H 1
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_set>
+
+// Decides where each output file lives below a root directory. With zero
+// levels files go straight into the root; otherwise each level adds a
+// directory named from one byte of a hash of the file name (e.g.
+// root/ab/cd/name.png), keeping every directory small. Every placement is
+// recorded in an index file in the root mapping file name to relative path.
+class OutputLayout {
+public:
+  OutputLayout(const std::filesystem::path &root, int levels,
+               const std::string &indexName="index.tsv");
+  ~OutputLayout() { Close(); }
+  // get the path of fileName relative to the root, creating its directory
+  std::filesystem::path Place(const std::string &fileName);
+  const std::filesystem::path &Root() const { return fRoot; }
+  void Close();
+
+private:
+  std::filesystem::path fRoot;
+  int fLevels;
+  std::ofstream fIndex;
+  // fan-out directories known to exist
+  std::unordered_set<std::string> fCreated;
+};
+
+#endif
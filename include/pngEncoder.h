@@ -0,0 +1,34 @@
+// -*- mode: C++; -*-
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H 1
+
+#include <string>
+#include <vector>
+
+// most distinct colours the palette encoder will take
+#ifndef PNG_MAX_PALETTE
+#define PNG_MAX_PALETTE 16
+#endif
+
+// a tEXt chunk: keyword (1-79 Latin-1 characters) and its value
+struct PngText {
+  std::string keyword;
+  std::string text;
+};
+
+// Encode an 8-bit RGB image as a palette PNG if it uses at most
+// PNG_MAX_PALETTE colours, packing pixels at 1, 2 or 4 bits. Rows are
+// compressed with a fast deflate that only looks for runs and repeats of
+// the row above, which is all a flat-shaded frame contains. Any text is
+// written as tEXt chunks ahead of the image data.
+//
+// Returns false, leaving out untouched, if the image has too many colours
+// for a palette; the caller should then fall back to a general encoder.
+bool encodePalettePng(std::vector<unsigned char> &out, const unsigned char *rgb,
+                      int width, int height, int stride,
+                      const std::vector<PngText> &text={});
+
+// add tEXt chunks straight after the IHDR chunk of an encoded PNG
+void insertPngText(std::vector<unsigned char> &png, const std::vector<PngText> &text);
+
+#endif
@@ -0,0 +1,48 @@
+// -*- mode: C++; -*-
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H 1
+
+#include <glad/glad.h>
+
+#include "labelWriter.h"
+#include "renderTarget.h"
+#include "shaderClass.h"
+#include "shaderVariants.h"
+
+// Full-screen shader passes applied to a rendered frame before it is read
+// back. Passes alternate between the frame and a scratch target of the
+// same size, so no pass reads the texture it is writing.
+class PostProcess {
+public:
+  PostProcess(int width, int height);
+  ~PostProcess() { Destroy(); }
+  // free the GL objects; must happen while the context is still current
+  void Destroy();
+  bool Complete() const { return fScratch.Complete(); }
+  // separable Gaussian blur with each sample's blurSigma, before the
+  // detector model
+  void EnableBlur(bool enable) { fBlur = enable; }
+  // SEM detector model: scan-line jitter, edge enhancement, shot and
+  // read noise, with the parameters and seed of each sample
+  void EnableDetector(bool enable) { fDetector = enable; }
+  // gamma, offset and saturation of the detector response, applied last
+  void EnableTransfer(bool enable) { fTransfer = enable; }
+  // run the enabled passes over frame; returns the target holding the
+  // result, which is frame itself when nothing is enabled
+  RenderTarget &Apply(RenderTarget &frame, const Sample &sample);
+
+private:
+  // draw a full-screen triangle into to with from bound as the input
+  void Pass(RenderTarget &from, RenderTarget &to);
+
+  RenderTarget fScratch;
+  GLuint fVAO;
+  Shader fBlurShader;
+  // the detector model and response curve share the last pass
+  ShaderVariants fFinalShaders;
+  bool fBlur;
+  bool fDetector;
+  bool fTransfer;
+};
+
+#endif
@@ -2,29 +2,86 @@
 #ifndef PROGRESS_BAR_H
 #define PROGRESS_BAR_H 1
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "utils.h"
+
+#ifndef PROGRESS_INTERVAL_MS
+#define PROGRESS_INTERVAL_MS 200
+#endif
+
+// number of independent counters threads are spread over
+#ifndef PROGRESS_SLOTS
+#define PROGRESS_SLOTS 16
+#endif
+
+enum class ProgressMode {
+  BAR, // human-readable bar redrawn in place on stderr
+  JSON // one JSON object per line on stdout
+};
+
+// Progress counters may be incremented from any number of threads. Each
+// thread adds to its own cache line, and a reporter thread started with
+// Start() sums them and redraws periodically, so workers never wait on
+// each other or on the terminal.
 class ProgressBar {
 public:
   ProgressBar(int length, double min, double max);
   ProgressBar(int length, double min, double max, bool showRaw);
-  ~ProgressBar() {}
+  ~ProgressBar() { Stop(); }
   void operator++() {
     Inc();
   }
-  void Inc() {
-    fValue += 1;
+  void Inc(uint64_t amount=1) {
+    LocalSlot().value.fetch_add(amount, std::memory_order_relaxed);
   }
-  void Inc(double amount) {
-    fValue += amount;
+  // count output bytes towards the MB/s figure
+  void AddBytes(uint64_t bytes) {
+    LocalSlot().bytes.fetch_add(bytes, std::memory_order_relaxed);
   }
+  // redraw from the calling thread, if at least the redraw interval has
+  // passed since the last one; not needed once Start() has been called
   void Display();
+  // redraw every interval from a background thread
+  void Start();
+  // stop any reporter thread, redraw unconditionally and end the line
+  void Finish();
   void SetShowRaw(bool v) { fShowRaw = v; }
+  void SetMode(ProgressMode mode, const std::string &label);
+  void SetInterval(double intervalMs);
 
 private:
-  double fValue;
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> value{0};
+    std::atomic<uint64_t> bytes{0};
+  };
+
+  Slot &LocalSlot();
+  void Stop();
+  void Report();
+  void Render(bool final);
+
+  Slot fSlots[PROGRESS_SLOTS];
   double fMin;
   double fMax;
   int fLength;
   bool fShowRaw;
+  ProgressMode fMode;
+  std::string fLabel;
+  double fIntervalMs;
+  std::chrono::steady_clock::time_point fStart;
+  RateLimiter fRedraw;
+
+  std::thread fReporter;
+  std::mutex fMutex;
+  std::condition_variable fWake;
+  bool fStopping;
 };
 
 #endif
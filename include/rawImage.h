@@ -0,0 +1,59 @@
+// -*- mode: C++; -*-
+#ifndef RAW_IMAGE_H
+#define RAW_IMAGE_H 1
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+enum class ImageFormat {
+  PNG,
+  PGM,      // binary greyscale netpbm
+  PPM,      // binary RGB netpbm
+  NPY,      // one NumPy array per image
+  NPY_BATCH // every image of a set in one (N, H, W[, C]) array
+};
+
+// file extension, including the dot, for images of a format
+const char *formatExtension(ImageFormat format);
+
+// Build a complete uncompressed PGM, PPM or NPY file from 8-bit RGB rows,
+// ready to be written with a single write. Headers are padded to 64 bytes
+// so the pixel data is aligned. Greyscale output (PGM, and NPY with one
+// channel) keeps the luma of each pixel, which for grey frames is exact.
+void encodeRawImage(std::vector<unsigned char> &out, ImageFormat format,
+                    const unsigned char *rgb, int width, int height, int stride,
+                    int channels);
+
+// Appends images to a single .npy file of shape (N, H, W) or (N, H, W, C),
+// one write per image. N is patched into the header on Close.
+class NpyBatchWriter {
+public:
+  NpyBatchWriter(const std::string &path, int width, int height, int channels);
+  ~NpyBatchWriter() { Close(); }
+  // append an image; returns its row in the array, or -1 if it could not
+  // be written
+  int64_t Append(const unsigned char *rgb, int stride);
+  void Close();
+  bool Good() const { return fFd >= 0; }
+  // number of failed writes, images and header alike
+  size_t Errors() const { return fErrors; }
+
+private:
+  void WriteHeader();
+
+  std::string fPath;
+  std::vector<unsigned char> fFrame;
+  int fFd;
+  int fWidth;
+  int fHeight;
+  int fChannels;
+  int64_t fCount;
+  // where row 0 starts, after the header
+  off_t fDataStart;
+  size_t fErrors;
+};
+
+#endif
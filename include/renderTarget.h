@@ -0,0 +1,36 @@
+// -*- mode: C++; -*-
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H 1
+
+#include <vector>
+#include <glad/glad.h>
+
+// A fixed-size offscreen framebuffer that frames are rendered into and read
+// back from, so the output resolution does not depend on the window.
+class RenderTarget {
+public:
+  RenderTarget(int width, int height);
+  ~RenderTarget() { Destroy(); }
+  // free the GL objects; must happen while the context is still current
+  void Destroy();
+  // direct drawing into the target
+  void Bind();
+  // read the target back as tightly packed 8-bit RGB
+  void ReadPixels(std::vector<unsigned char> &out);
+  // copy the target into the window's framebuffer, scaled to fit; with
+  // flipY the image is mirrored vertically on the way
+  void BlitToWindow(int windowWidth, int windowHeight, bool flipY);
+  int Width() const { return fWidth; }
+  int Height() const { return fHeight; }
+  GLuint Texture() const { return fTexture; }
+  bool Complete() const { return fComplete; }
+
+private:
+  GLuint fFBO;
+  GLuint fTexture;
+  int fWidth;
+  int fHeight;
+  bool fComplete;
+};
+
+#endif
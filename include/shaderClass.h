@@ -7,19 +7,37 @@
 class Shader {
  private:
   GLuint getUniformLocation(const std::string &name) const;
+  void build(const std::string &vertexSrc, const std::string &fragSrc,
+             const std::string &vertexName, const std::string &fragName);
+  bool loadBinary(const std::string &cachePath);
+  void saveBinary(const std::string &cachePath) const;
  public:
   GLuint ID; // shader program ID
-  
+
+  // selects the constructor taking GLSL source rather than file paths
+  static constexpr struct FromSourceTag {} FromSource{};
+
   Shader(const char* vertexShaderPath, const char* fragShaderPath);
+  Shader(FromSourceTag, const std::string &vertexSrc, const std::string &fragSrc,
+         const std::string &name="embedded");
   void use();
 
+  // Cache linked programs in dir, keyed by a hash of their sources and the
+  // GL driver, and reload them on later runs instead of compiling. Needs
+  // glGetProgramBinary (GL 4.1 or ARB_get_program_binary), looked up with
+  // load; returns false, leaving the cache off, if it is not available.
+  static bool enableBinaryCache(const std::string &dir, GLADloadproc load);
+
   // utilities
   void setUniform(const std::string &name, bool value) const;
   void setUniform(const std::string &name, int value) const;
+  void setUniform(const std::string &name, unsigned value) const;
   void setUniform(const std::string &name, float value) const;
   void setUniform(const std::string &name, float v1, float v2, float v3, float v4) const;
   void setUniform(const std::string &name, float v1, float v2) const;
   void setUniform(const std::string &name, float v1, float v2, float v3) const;
+  // column-major 2x2 matrix
+  void setUniform(const std::string &name, const float matrix[4]) const;
 
   // utility aliases for convenience
   void setBool(const std::string &name, bool value) const {
@@ -28,6 +46,9 @@ class Shader {
   void setInt(const std::string &name, int value) const {
     setUniform(name, (int)value);
   }
+  void setUInt(const std::string &name, unsigned value) const {
+    setUniform(name, (unsigned)value);
+  }
   void setFloat(const std::string &name, float value) const {
     setUniform(name, (float)value);
   }
@@ -41,5 +62,8 @@ class Shader {
   void set3Vec(const std::string &name, float v1, float v2, float v3) const {
     setUniform(name, v1, v2, v3);
   }
+  void set2Mat(const std::string &name, const float matrix[4]) const {
+    setUniform(name, matrix);
+  }
 };
 #endif
@@ -0,0 +1,36 @@
+// -*- mode: C++; -*-
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H 1
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaderClass.h"
+
+// Builds specialised programs from one pair of shader sources. Feature i
+// of a variant's bit mask defines the preprocessor symbol features[i] at
+// the top of both shaders, so features cost nothing at run time when off.
+// Each variant is compiled (or loaded from the binary cache) the first
+// time it is asked for and kept for reuse.
+class ShaderVariants {
+public:
+  ShaderVariants(const std::string &vertexSrc, const std::string &fragSrc,
+                 const std::vector<std::string> &features, const std::string &name);
+  // the program with exactly the given features
+  Shader &Get(unsigned features);
+  // delete the programs built so far; the context must still be current
+  void Destroy();
+  // insert #defines for the features after the #version line of src
+  std::string Specialize(const std::string &src, unsigned features) const;
+
+private:
+  std::string fVertexSrc;
+  std::string fFragSrc;
+  std::vector<std::string> fFeatures;
+  std::string fName;
+  std::map<unsigned, std::unique_ptr<Shader>> fVariants;
+};
+
+#endif
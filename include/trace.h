@@ -0,0 +1,80 @@
+// -*- mode: C++; -*-
+#ifndef TRACE_H
+#define TRACE_H 1
+
+// Hot-path trace spans, recorded into a fixed-size ring buffer and dumped
+// as Chrome trace JSON (chrome://tracing, ui.perfetto.dev). Spans are only
+// compiled in when ENABLE_TRACING is defined (cmake -DENABLE_TRACING=ON),
+// and only recorded once Tracer::Enable() has been called.
+
+#ifndef TRACE_CAPACITY
+#define TRACE_CAPACITY (1 << 20)
+#endif
+
+#ifdef ENABLE_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Tracer {
+public:
+  static Tracer &Get();
+  ~Tracer() { Dump(); }
+  // start recording; the trace is written to path by Dump(), or on exit
+  void Enable(const std::string &path, size_t capacity=TRACE_CAPACITY);
+  bool Enabled() const { return fEnabled.load(std::memory_order_relaxed); }
+  // name must outlive the tracer, e.g. a string literal
+  void Record(const char *name, uint64_t startNs, uint64_t endNs);
+  void Dump();
+  static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+private:
+  struct Event {
+    const char *name;
+    uint64_t startNs;
+    uint64_t endNs;
+    uint32_t thread;
+  };
+  Tracer() {}
+
+  std::atomic<bool> fEnabled{false};
+  std::atomic<uint64_t> fNext{0};
+  std::vector<Event> fEvents;
+  std::string fPath;
+};
+
+class TraceScope {
+public:
+  TraceScope(const char *name) : fName(name), fStart(0) {
+    if (Tracer::Get().Enabled()) {
+      fStart = Tracer::Now();
+    }
+  }
+  ~TraceScope() {
+    if (fStart) {
+      Tracer::Get().Record(fName, fStart, Tracer::Now());
+    }
+  }
+
+private:
+  const char *fName;
+  uint64_t fStart;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+
+#endif // ENABLE_TRACING
+
+#endif
@@ -1,27 +1,37 @@
 #ifndef TRIANGLE_CLASS_H
 #define TRIANGLE_CLASS_H 1
 
-#ifndef MAX_DISTANCE_PLACES
-#define MAX_DISTANCE_PLACES 5
-#endif
-
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <vector>
 #include <glad/glad.h>
 
+#include "labelWriter.h"
+
 class Triangle {
 private:
   float fCOM[2];
   float fVertices[9];
-  float fMaxDistance;
-  int fMaxDistanceMod;
+  float fBoundsMargin;
+  // {minX, maxX, minY, maxY} of the rotated triangle for each angle step
+  std::vector<float> fBounds;
+  // vertices of the last draw as (x, y, z, shade), the triangle's with a
+  // negative shade and distractors' already placed
+  std::vector<float> fBatch;
+  size_t fBufferFloats;
+  bool fTriangleOnly;
   GLuint VBO;
   GLuint VAO;
+
+  void BuildBoundsTable();
+  void AppendPolygon(const Distractor &distractor);
 public:
   Triangle(const float vertiecs[9]);
   ~Triangle() {};
-  void GenerateDisplacements(float &outXDisp, float &outYDisp, float multiplier=1.0);
-  void Draw();
+  void GetBounds(float angle, float outBounds[4]) const;
+  void GenerateDisplacements(float angle, float &outXDisp, float &outYDisp, float multiplier=1.0);
+  // draw the triangle and any distractors with a single draw call
+  void Draw(const std::vector<Distractor> &distractors = {});
 };
 
 #endif
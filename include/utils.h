@@ -1,10 +1,30 @@
 #ifndef UTILS_H
 #define UTILS_H 1
 
+#include <chrono>
+
+// resolution of the sin/cos lookup table
+#ifndef TRIG_STEPS_PER_DEGREE
+#define TRIG_STEPS_PER_DEGREE 100
+#endif
+
 float floorTo(float value, int places);
 
 float randFloat();
 float randFloat(const float min, const float max);
 
+// sin and cos of an angle in degrees, rounded to the nearest table step
+void sinCosDegrees(float angle, float &outSin, float &outCos);
+
+// returns true from Ready() at most once per interval
+class RateLimiter {
+public:
+  RateLimiter(double intervalMs);
+  bool Ready();
+
+private:
+  std::chrono::steady_clock::duration fInterval;
+  std::chrono::steady_clock::time_point fNext;
+};
 
 #endif
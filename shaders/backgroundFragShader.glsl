@@ -0,0 +1,78 @@
+#version 330 core
+out vec4 FragColor;
+
+// procedural substrate: a pattern in [0, 1] scaled by amplitude on top of
+// the sample's background shade, which stays the darkest level
+uniform float shade;
+uniform float amplitude;
+uniform vec2 resolution;
+#ifdef GRADIENT
+// unit vector the gradient brightens along
+uniform vec2 direction;
+#endif
+#ifdef IMAGE
+uniform sampler2DArray library;
+uniform float layer;
+// region of the layer stretched over the frame: x, y, width, height in texels
+uniform vec4 crop;
+#endif
+#ifdef VALUE_NOISE
+// size of the coarsest noise cells, in pixels
+uniform float scale;
+uniform uint seed;
+
+#define OCTAVES 4
+
+// PCG hash
+uint hash(uint v) {
+     uint state = v * 747796405u + 2891336453u;
+     uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+     return (word >> 22u) ^ word;
+}
+
+// random value in [0, 1] at a lattice point of the given octave
+float lattice(ivec2 cell, uint octave) {
+     uint h = hash(seed ^ hash(uint(cell.x) ^ hash(uint(cell.y) ^ hash(octave))));
+     return float(h >> 8u) / 16777215.0;
+}
+
+// smoothly interpolated lattice values
+float valueNoise(vec2 p, uint octave) {
+     ivec2 cell = ivec2(floor(p));
+     vec2 f = fract(p);
+     vec2 u = f*f*(3.0 - 2.0*f);
+     return mix(mix(lattice(cell, octave), lattice(cell + ivec2(1, 0), octave), u.x),
+                mix(lattice(cell + ivec2(0, 1), octave), lattice(cell + ivec2(1, 1), octave), u.x),
+                u.y);
+}
+#endif
+
+void main() {
+     float pattern = 0.0;
+#ifdef GRADIENT
+     // 0 to 1 across the frame along direction
+     vec2 centred = gl_FragCoord.xy/resolution - 0.5;
+     pattern = 0.5 + dot(centred, direction) / (abs(direction.x) + abs(direction.y));
+#endif
+#ifdef VALUE_NOISE
+     // fractal sum of octaves, each half the size and weight of the last
+     float weight = 1.0;
+     float total = 0.0;
+     vec2 p = gl_FragCoord.xy / scale;
+     for (int octave = 0; octave < OCTAVES; ++octave) {
+          pattern += weight*valueNoise(p, uint(octave));
+          total += weight;
+          weight *= 0.5;
+          p *= 2.0;
+     }
+     pattern /= total;
+#endif
+#ifdef IMAGE
+     vec2 texel = crop.xy + gl_FragCoord.xy/resolution*crop.zw;
+     // stay half a texel inside the image, so linear filtering never blends
+     // in the unused (undefined) part of a layer larger than it
+     texel = clamp(texel, vec2(0.5), crop.xy + crop.zw - 0.5);
+     pattern = texture(library, vec3(texel/vec2(textureSize(library, 0).xy), layer)).r;
+#endif
+     FragColor = vec4(vec3(clamp(shade + amplitude*pattern, 0.0, 1.0)), 1.0);
+}
\ No newline at end of file
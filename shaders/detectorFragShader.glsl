@@ -0,0 +1,100 @@
+#version 330 core
+out vec4 FragColor;
+
+// last pass over a frame, with up to two features: the SEM detector model
+// (DETECTOR), where the frame is sampled along jittered scan lines, edges
+// are brightened, and shot and read noise are added; and the detector's
+// response curve (TRANSFER)
+uniform sampler2D frame;
+#ifdef DETECTOR
+uniform uint seed;
+// mean detected electrons per unit of intensity; 0 disables shot noise
+uniform float shotCount;
+// standard deviation of the additive detector noise
+uniform float readNoise;
+// standard deviation of the horizontal offset of each scan line, in pixels
+uniform float jitter;
+// brightness added per unit of intensity gradient (the SEM edge effect)
+uniform float edgeGain;
+#endif
+#ifdef TRANSFER
+uniform float gamma;
+// added after the gamma curve
+uniform float intensityOffset;
+// intensity at which the detector saturates and the output is white
+uniform float saturation;
+#endif
+
+#ifdef DETECTOR
+// PCG hash, giving an independent stream per pixel and sample
+uint hash(uint v) {
+     uint state = v * 747796405u + 2891336453u;
+     uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+     return (word >> 22u) ^ word;
+}
+
+// uniform in (0, 1)
+float uniformRand(inout uint state) {
+     state = hash(state);
+     return (float(state >> 8u) + 0.5) / 16777216.0;
+}
+
+// standard normal (Box-Muller)
+float gaussianRand(inout uint state) {
+     float u1 = uniformRand(state);
+     float u2 = uniformRand(state);
+     return sqrt(-2.0*log(u1)) * cos(6.28318530718*u2);
+}
+
+// Poisson with the given mean; exact for small means, normal approximation
+// above that where the two are indistinguishable at 8 bits
+float poissonRand(float mean, inout uint state) {
+     if (mean >= 16.0) {
+          return max(mean + sqrt(mean)*gaussianRand(state), 0.0);
+     }
+     float limit = exp(-mean);
+     float product = uniformRand(state);
+     float count = 0.0;
+     while (product > limit && count < 64.0) {
+          product *= uniformRand(state);
+          count += 1.0;
+     }
+     return count;
+}
+
+// intensity at a fractional x on row y, interpolated between texels
+float intensity(float x, int y) {
+     ivec2 size = textureSize(frame, 0);
+     x = clamp(x, 0.0, float(size.x - 1));
+     y = clamp(y, 0, size.y - 1);
+     int x0 = int(x);
+     int x1 = min(x0 + 1, size.x - 1);
+     return mix(texelFetch(frame, ivec2(x0, y), 0).r,
+                texelFetch(frame, ivec2(x1, y), 0).r, x - float(x0));
+}
+#endif
+
+void main() {
+     ivec2 pixel = ivec2(gl_FragCoord.xy);
+#ifdef DETECTOR
+     uint rowState = hash(seed ^ hash(uint(pixel.y)));
+     uint state = hash(rowState ^ uint(pixel.x));
+
+     float x = float(pixel.x) + jitter*gaussianRand(rowState);
+     float signal = intensity(x, pixel.y);
+     vec2 gradient = 0.5*vec2(intensity(x + 1.0, pixel.y) - intensity(x - 1.0, pixel.y),
+                              intensity(x, pixel.y + 1) - intensity(x, pixel.y - 1));
+     signal += edgeGain*length(gradient);
+
+     if (shotCount > 0.0) {
+          signal = poissonRand(signal*shotCount, state) / shotCount;
+     }
+     signal += readNoise*gaussianRand(state);
+#else
+     float signal = texelFetch(frame, pixel, 0).r;
+#endif
+#ifdef TRANSFER
+     signal = (pow(max(signal, 0.0), gamma) + intensityOffset) / saturation;
+#endif
+     FragColor = vec4(vec3(clamp(signal, 0.0, 1.0)), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 330 core
+out vec4 FragColor;
+
+// one direction of a separable Gaussian blur, modelling the beam spot
+uniform sampler2D frame;
+uniform float sigma;
+// (1, 0) for the horizontal pass, (0, 1) for the vertical one
+uniform vec2 direction;
+
+// taps either side of the centre; limits sigma to about MAX_RADIUS/3
+#define MAX_RADIUS 32
+
+void main() {
+     ivec2 pixel = ivec2(gl_FragCoord.xy);
+     ivec2 delta = ivec2(direction);
+     ivec2 last = textureSize(frame, 0) - 1;
+     int radius = min(int(ceil(3.0*sigma)), MAX_RADIUS);
+     float scale = -0.5 / (sigma*sigma);
+
+     float sum = texelFetch(frame, pixel, 0).r;
+     float total = 1.0;
+     for (int i = 1; i <= radius; ++i) {
+          float weight = exp(scale*float(i*i));
+          sum += weight*(texelFetch(frame, clamp(pixel + i*delta, ivec2(0), last), 0).r +
+                         texelFetch(frame, clamp(pixel - i*delta, ivec2(0), last), 0).r);
+          total += 2.0*weight;
+     }
+     FragColor = vec4(vec3(sum/total), 1.0);
+}
\ No newline at end of file
@@ -1,8 +1,19 @@
 #version 330 core
 out vec4 FragColor;
 
+// the vertex shade, negative inside the triangle
+flat in float shade;
+
+#ifdef GRAYSCALE
+uniform float triShade;
+#else
 uniform vec3 triColor;
+#endif
 
 void main() {
-     FragColor = vec4(triColor, 1.0f);
+#ifdef GRAYSCALE
+     FragColor = vec4(vec3(shade < 0.0 ? triShade : shade), 1.0f);
+#else
+     FragColor = vec4(shade < 0.0 ? triColor : vec3(shade), 1.0f);
+#endif
 }
\ No newline at end of file
@@ -1,15 +1,25 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+// shade of a distractor vertex, which is already in place; negative for
+// the vertices of the triangle
+layout (location = 1) in float aShade;
 
-uniform float theta;
+// rotation of the triangle, precomputed per sample
+uniform mat2 rotation;
 uniform float xDisp;
 uniform float yDisp;
 
+flat out float shade;
+
 void main() {
-     mat3 rotMatrix;
-     rotMatrix[0] = vec3(cos(theta), -sin(theta), 0);
-     rotMatrix[1] = vec3(sin(theta), cos(theta), 0);
-     rotMatrix[2] = vec3(0, 0, 1);
-     vec3 newPos = rotMatrix * aPos;
-     gl_Position = vec4(newPos.x+xDisp, newPos.y+yDisp, newPos.z, 1.0);
+     vec2 pos = aPos.xy;
+     if (aShade < 0.0) {
+          pos = rotation * aPos.xy + vec2(xDisp, yDisp);
+     }
+#ifdef FLIP_Y
+     // draw upside down, so that glReadPixels returns rows top-down
+     pos.y = -pos.y;
+#endif
+     gl_Position = vec4(pos, aPos.z, 1.0);
+     shade = aShade;
 }
\ No newline at end of file
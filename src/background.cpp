@@ -0,0 +1,69 @@
+#include <algorithm>
+
+#include "background.h"
+#include "embeddedShaders.h"
+#include "utils.h"
+
+// shader variants of the background pass
+enum BackgroundFeature {
+  BG_GRADIENT = 1 << 0,
+  BG_VALUE_NOISE = 1 << 1,
+  BG_IMAGE = 1 << 2
+};
+
+Background::Background(int width, int height)
+  : fShaders(fullscreenVertShaderSrc, backgroundFragShaderSrc, {"GRADIENT", "VALUE_NOISE", "IMAGE"},
+             "background"),
+    fLibrary(nullptr), fVAO(0), fWidth(width), fHeight(height) {
+  glGenVertexArrays(1, &fVAO);
+  // build the variants now rather than stalling on the first sample
+  fShaders.Get(BG_GRADIENT);
+  fShaders.Get(BG_VALUE_NOISE);
+  fShaders.Get(BG_IMAGE);
+}
+
+void Background::Destroy() {
+  if (fVAO) {
+    glDeleteVertexArrays(1, &fVAO);
+    fShaders.Destroy();
+    fVAO = 0;
+  }
+}
+
+void Background::Draw(const Sample &sample) {
+  const BackgroundType type = (BackgroundType)sample.bgType;
+  if (type == BackgroundType::FLAT || sample.bgAmplitude <= 0 ||
+      (type == BackgroundType::IMAGE && !fLibrary)) {
+    glClearColor(sample.bgShade, sample.bgShade, sample.bgShade, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    return;
+  }
+
+  // the pass covers every pixel, so no clear is needed
+  const unsigned feature = type == BackgroundType::GRADIENT ? BG_GRADIENT :
+                           type == BackgroundType::IMAGE ? BG_IMAGE : BG_VALUE_NOISE;
+  Shader &shader = fShaders.Get(feature);
+  shader.use();
+  shader.setFloat("shade", sample.bgShade);
+  shader.setFloat("amplitude", sample.bgAmplitude);
+  shader.set2Vec("resolution", fWidth, fHeight);
+  if (type == BackgroundType::GRADIENT) {
+    float s, c;
+    sinCosDegrees(sample.bgAngle, s, c);
+    shader.set2Vec("direction", c, s);
+  } else if (type == BackgroundType::IMAGE) {
+    // a frame-sized window of the image, or all of it when it is smaller
+    const int width = std::min(fLibrary->Width(sample.bgLayer), fWidth);
+    const int height = std::min(fLibrary->Height(sample.bgLayer), fHeight);
+    shader.setInt("library", 0);
+    shader.setFloat("layer", sample.bgLayer);
+    shader.set4Vec("crop", sample.bgCropX, sample.bgCropY, width, height);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, fLibrary->Texture());
+  } else {
+    shader.setFloat("scale", sample.bgScale);
+    shader.setUInt("seed", sample.bgSeed);
+  }
+  glBindVertexArray(fVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
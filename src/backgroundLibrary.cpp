@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "stb/stb_image.h"
+
+#include "backgroundLibrary.h"
+
+BackgroundLibrary::BackgroundLibrary(const std::string &dir, int threads) : fTexture(0) {
+  std::vector<std::string> candidates;
+  std::error_code error;
+  for (const auto &entry : std::filesystem::directory_iterator(dir, error)) {
+    if (entry.is_regular_file()) {
+      candidates.push_back(entry.path().string());
+    }
+  }
+  if (error) {
+    std::cerr << "ERROR::BACKGROUND_LIBRARY::FAILED_TO_READ: '" << dir << "': "
+              << error.message() << std::endl;
+    return;
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  GLint maxSize, maxLayers;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+  // read just the headers first, to size the array before decoding
+  std::vector<std::string> paths;
+  int width = 0;
+  int height = 0;
+  for (const std::string &path : candidates) {
+    int w, h, channels;
+    if (!stbi_info(path.c_str(), &w, &h, &channels)) {
+      std::cerr << "ERROR::BACKGROUND_LIBRARY::NOT_AN_IMAGE: '" << path << "'" << std::endl;
+      continue;
+    }
+    if (w > maxSize || h > maxSize) {
+      std::cerr << "ERROR::BACKGROUND_LIBRARY::TOO_LARGE: '" << path << "' is " << w << "x" << h
+                << ", the limit is " << maxSize << std::endl;
+      continue;
+    }
+    if ((GLint)paths.size() == maxLayers) {
+      std::cerr << "ERROR::BACKGROUND_LIBRARY::TOO_MANY_IMAGES: using the first " << maxLayers
+                << std::endl;
+      break;
+    }
+    paths.push_back(path);
+    fExtents.push_back(Extent{w, h});
+    width = std::max(width, w);
+    height = std::max(height, h);
+  }
+  if (paths.empty()) {
+    return;
+  }
+
+  glGenTextures(1, &fTexture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, fTexture);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, width, height, paths.size(), 0, GL_RED,
+               GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  // The threads decode while this one uploads, which has to happen on the
+  // GL thread. The queue between them is bounded, so at most a few decoded
+  // images are held in memory at once.
+  struct Decoded {
+    int layer;
+    int width;
+    int height;
+    unsigned char *pixels;
+  };
+  std::deque<Decoded> queue;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable space;
+  const size_t queueLimit = BACKGROUND_QUEUE_PER_THREAD * std::max(threads, 1);
+  std::atomic<int> next(0);
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < std::max(threads, 1); ++t) {
+    workers.emplace_back([&]() {
+      for (int layer = next++; layer < (int)paths.size(); layer = next++) {
+        Decoded image{layer, 0, 0, nullptr};
+        int channels;
+        // greyscale, like the frames
+        image.pixels = stbi_load(paths[layer].c_str(), &image.width, &image.height, &channels, 1);
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [&]() { return queue.size() < queueLimit; });
+        queue.push_back(image);
+        ready.notify_one();
+      }
+    });
+  }
+
+  for (size_t uploaded = 0; uploaded < paths.size(); ++uploaded) {
+    Decoded image;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [&]() { return !queue.empty(); });
+      image = queue.front();
+      queue.pop_front();
+      space.notify_one();
+    }
+    Extent &extent = fExtents[image.layer];
+    if (!image.pixels || image.width != extent.width || image.height != extent.height) {
+      std::cerr << "ERROR::BACKGROUND_LIBRARY::FAILED_TO_DECODE: '" << paths[image.layer] << "'"
+                << std::endl;
+      extent = Extent{0, 0};
+    } else {
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, image.layer, image.width, image.height, 1,
+                      GL_RED, GL_UNSIGNED_BYTE, image.pixels);
+    }
+    stbi_image_free(image.pixels);
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  for (size_t layer = 0; layer < fExtents.size(); ++layer) {
+    if (fExtents[layer].width) {
+      fLoaded.push_back(layer);
+    }
+  }
+}
+
+void BackgroundLibrary::Destroy() {
+  if (fTexture) {
+    glDeleteTextures(1, &fTexture);
+    fTexture = 0;
+  }
+}
@@ -0,0 +1,533 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// sparse direct descriptors need the 5.19 headers; older ones fall back
+#ifdef IORING_RSRC_REGISTER_SPARSE
+#define HAVE_IO_URING 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "fileWriter.h"
+#include "trace.h"
+
+constexpr int fileWriterBatch = FILE_WRITER_BATCH;
+constexpr size_t fileWriterQueueDepth = FILE_WRITER_QUEUE_DEPTH;
+
+// write a whole buffer with plain syscalls; returns false on failure
+static bool writeFileSync(const std::string &path, const std::vector<unsigned char> &data) {
+  TRACE_SCOPE("write_file");
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "ERROR::WRITER::OPEN_FAILED: '" << path << "'; " << strerror(errno) << std::endl;
+    return false;
+  }
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t n = write(fd, data.data() + done, data.size() - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "ERROR::WRITER::WRITE_FAILED: '" << path << "'; " << strerror(errno) << std::endl;
+      close(fd);
+      return false;
+    }
+    done += n;
+  }
+  return close(fd) == 0;
+}
+
+/* Synchronous writer */
+
+class SyncFileWriter : public FileWriter {
+public:
+  void Submit(const std::string &path, std::vector<unsigned char> &&data) override {
+    if (!writeFileSync(path, data)) {
+      ++fErrors;
+    }
+  }
+  void Flush() override {}
+  size_t Errors() const override { return fErrors; }
+  size_t Pending() const override { return 0; }
+
+private:
+  size_t fErrors = 0;
+};
+
+/* Thread pool writer */
+
+class ThreadPoolFileWriter : public FileWriter {
+public:
+  ThreadPoolFileWriter(int threads);
+  ~ThreadPoolFileWriter();
+  void Submit(const std::string &path, std::vector<unsigned char> &&data) override;
+  void Flush() override;
+  size_t Errors() const override { return fErrors; }
+  size_t Pending() const override { return fInFlight; }
+
+private:
+  struct Job {
+    std::string path;
+    std::vector<unsigned char> data;
+  };
+  void Work();
+
+  std::vector<std::thread> fThreads;
+  std::deque<Job> fQueue;
+  std::mutex fMutex;
+  std::condition_variable fWorkReady;
+  std::condition_variable fSpaceReady;
+  std::atomic<size_t> fInFlight;
+  std::atomic<size_t> fErrors;
+  bool fStopping;
+};
+
+ThreadPoolFileWriter::ThreadPoolFileWriter(int threads)
+  : fInFlight(0), fErrors(0), fStopping(false) {
+  if (threads < 1) {
+    threads = 1;
+  }
+  for (int i = 0; i < threads; ++i) {
+    fThreads.emplace_back(&ThreadPoolFileWriter::Work, this);
+  }
+}
+
+ThreadPoolFileWriter::~ThreadPoolFileWriter() {
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStopping = true;
+  }
+  fWorkReady.notify_all();
+  for (std::thread &thread : fThreads) {
+    thread.join();
+  }
+}
+
+void ThreadPoolFileWriter::Submit(const std::string &path, std::vector<unsigned char> &&data) {
+  std::unique_lock<std::mutex> lock(fMutex);
+  // bound the memory held by queued buffers
+  fSpaceReady.wait(lock, [this] { return fQueue.size() < fileWriterQueueDepth; });
+  fQueue.push_back(Job{path, std::move(data)});
+  ++fInFlight;
+  lock.unlock();
+  fWorkReady.notify_one();
+}
+
+void ThreadPoolFileWriter::Flush() {
+  std::unique_lock<std::mutex> lock(fMutex);
+  fSpaceReady.wait(lock, [this] { return fInFlight == 0; });
+}
+
+void ThreadPoolFileWriter::Work() {
+  for (;;) {
+    std::unique_lock<std::mutex> lock(fMutex);
+    fWorkReady.wait(lock, [this] { return fStopping || !fQueue.empty(); });
+    if (fQueue.empty()) {
+      return;
+    }
+    Job job = std::move(fQueue.front());
+    fQueue.pop_front();
+    lock.unlock();
+
+    if (!writeFileSync(job.path, job.data)) {
+      ++fErrors;
+    }
+
+    lock.lock();
+    --fInFlight;
+    lock.unlock();
+    // both Submit (waiting for space) and Flush (waiting for drain) listen here
+    fSpaceReady.notify_all();
+  }
+}
+
+/* io_uring writer */
+
+#ifdef HAVE_IO_URING
+
+// Each file is one linked chain: OPENAT into a registered (direct) file
+// slot, WRITE through that slot and CLOSE it, so a whole batch of files
+// costs a single io_uring_enter. Two batches of slots are alternated so
+// one batch is in flight while the next is being filled.
+class UringFileWriter : public FileWriter {
+public:
+  ~UringFileWriter();
+  bool Init();
+  void Submit(const std::string &path, std::vector<unsigned char> &&data) override;
+  void Flush() override;
+  size_t Errors() const override { return fErrors; }
+  size_t Pending() const override { return fPending; }
+
+private:
+  struct Job {
+    std::string path;
+    std::vector<unsigned char> data;
+  };
+  bool Probe();
+  io_uring_sqe *NextSqe();
+  unsigned Drain();
+  void SubmitBatch();
+  void Reap(int batch);
+
+  int fRingFd = -1;
+  void *fSqRing = nullptr;
+  void *fCqRing = nullptr;
+  size_t fSqRingSize = 0;
+  size_t fCqRingSize = 0;
+  io_uring_sqe *fSqes = nullptr;
+  size_t fSqesSize = 0;
+  unsigned *fSqHead, *fSqTail, *fSqMask, *fSqArray;
+  unsigned *fCqHead, *fCqTail, *fCqMask;
+  io_uring_cqe *fCqes;
+
+  std::vector<Job> fBatches[2];
+  // per batch: chains that failed, completions still to come, and how many
+  // jobs had their whole chain submitted
+  std::vector<bool> fFailed[2];
+  unsigned fInFlight[2] = {0, 0};
+  size_t fSubmittedJobs[2] = {0, 0};
+  int fFilling = 0;
+  size_t fErrors = 0;
+  // files written synchronously because their chain failed or was never
+  // submitted, and the first error a chain reported
+  size_t fFallbacks = 0;
+  int fChainError = 0;
+  std::atomic<size_t> fPending{0};
+};
+
+static int ioUringSetup(unsigned entries, io_uring_params *params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+  return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+bool UringFileWriter::Init() {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  // three entries per file chain
+  fRingFd = ioUringSetup(3*fileWriterBatch, &params);
+  if (fRingFd < 0) {
+    return false;
+  }
+
+  fSqRingSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+  fCqRingSize = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    fSqRingSize = fCqRingSize = std::max(fSqRingSize, fCqRingSize);
+  }
+  fSqRing = mmap(nullptr, fSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 fRingFd, IORING_OFF_SQ_RING);
+  if (fSqRing == MAP_FAILED) {
+    fSqRing = nullptr;
+    return false;
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    fCqRing = fSqRing;
+  } else {
+    fCqRing = mmap(nullptr, fCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   fRingFd, IORING_OFF_CQ_RING);
+    if (fCqRing == MAP_FAILED) {
+      fCqRing = nullptr;
+      return false;
+    }
+  }
+  fSqesSize = params.sq_entries*sizeof(io_uring_sqe);
+  void *sqes = mmap(nullptr, fSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fRingFd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return false;
+  }
+  fSqes = (io_uring_sqe*)sqes;
+
+  char *sq = (char*)fSqRing;
+  fSqHead = (unsigned*)(sq + params.sq_off.head);
+  fSqTail = (unsigned*)(sq + params.sq_off.tail);
+  fSqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+  fSqArray = (unsigned*)(sq + params.sq_off.array);
+  char *cq = (char*)fCqRing;
+  fCqHead = (unsigned*)(cq + params.cq_off.head);
+  fCqTail = (unsigned*)(cq + params.cq_off.tail);
+  fCqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+  fCqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+  // sparse table of direct descriptors, one per file of both batches
+  io_uring_rsrc_register files;
+  memset(&files, 0, sizeof(files));
+  files.nr = 2*fileWriterBatch;
+  files.flags = IORING_RSRC_REGISTER_SPARSE;
+  if (ioUringRegister(fRingFd, IORING_REGISTER_FILES2, &files, sizeof(files)) < 0) {
+    return false;
+  }
+
+  fBatches[0].reserve(fileWriterBatch);
+  fBatches[1].reserve(fileWriterBatch);
+  return Probe();
+}
+
+// write one file through the ring and check that it needed no fallback,
+// so a kernel that accepts the setup but fails the chains is not used
+bool UringFileWriter::Probe() {
+  std::error_code error;
+  const std::filesystem::path path = std::filesystem::temp_directory_path(error) /
+    ("2d_rot_generator_uring_probe." + std::to_string(getpid()));
+  if (error) {
+    return true;
+  }
+  const std::vector<unsigned char> probe = {'p', 'r', 'o', 'b', 'e'};
+  fBatches[fFilling].push_back(Job{path.string(), probe});
+  ++fPending;
+  SubmitBatch();
+  Reap(1 - fFilling);
+
+  std::vector<unsigned char> written(probe.size() + 1);
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  const ssize_t size = fd >= 0 ? read(fd, written.data(), written.size()) : -1;
+  if (fd >= 0) {
+    close(fd);
+  }
+  std::filesystem::remove(path, error);
+  written.resize(size < 0 ? 0 : size);
+
+  const bool ok = fFallbacks == 0 && fErrors == 0 && written == probe;
+  fFallbacks = 0;
+  fErrors = 0;
+  fChainError = 0;
+  if (!ok) {
+    errno = EIO;
+  }
+  return ok;
+}
+
+UringFileWriter::~UringFileWriter() {
+  if (fRingFd >= 0 && fSqes) {
+    Flush();
+  }
+  if (fFallbacks) {
+    std::cerr << fFallbacks << " files fell back to synchronous writes after io_uring failures"
+              << std::endl;
+  }
+  if (fSqes) {
+    munmap(fSqes, fSqesSize);
+  }
+  if (fCqRing && fCqRing != fSqRing) {
+    munmap(fCqRing, fCqRingSize);
+  }
+  if (fSqRing) {
+    munmap(fSqRing, fSqRingSize);
+  }
+  if (fRingFd >= 0) {
+    close(fRingFd);
+  }
+}
+
+io_uring_sqe *UringFileWriter::NextSqe() {
+  const unsigned tail = *fSqTail;
+  const unsigned index = tail & *fSqMask;
+  io_uring_sqe *sqe = &fSqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  fSqArray[index] = index;
+  __atomic_store_n(fSqTail, tail + 1, __ATOMIC_RELEASE);
+  return sqe;
+}
+
+void UringFileWriter::Submit(const std::string &path, std::vector<unsigned char> &&data) {
+  fBatches[fFilling].push_back(Job{path, std::move(data)});
+  ++fPending;
+  if ((int)fBatches[fFilling].size() == fileWriterBatch) {
+    SubmitBatch();
+  }
+}
+
+// consume the completions posted so far; returns how many there were
+unsigned UringFileWriter::Drain() {
+  unsigned head = *fCqHead;
+  const unsigned tail = __atomic_load_n(fCqTail, __ATOMIC_ACQUIRE);
+  const unsigned count = tail - head;
+  for (; head != tail; ++head) {
+    const io_uring_cqe &cqe = fCqes[head & *fCqMask];
+    // user_data holds the batch in the high half and the job in the low
+    const int batch = cqe.user_data >> 32;
+    const size_t job = cqe.user_data & 0xffffffffu;
+    if (cqe.res < 0 && job < fFailed[batch].size()) {
+      fFailed[batch][job] = true;
+      // the rest of a broken chain only reports ECANCELED
+      if (!fChainError && cqe.res != -ECANCELED) {
+        fChainError = -cqe.res;
+      }
+    }
+    --fInFlight[batch];
+  }
+  __atomic_store_n(fCqHead, head, __ATOMIC_RELEASE);
+  return count;
+}
+
+void UringFileWriter::SubmitBatch() {
+  TRACE_SCOPE("uring_submit");
+  // the other batch's slots and buffers must be free before we reuse them
+  const int other = 1 - fFilling;
+  Reap(other);
+
+  std::vector<Job> &jobs = fBatches[fFilling];
+  fFailed[fFilling].assign(jobs.size(), false);
+  const unsigned slotBase = fFilling*fileWriterBatch;
+  const uint64_t batchTag = (uint64_t)fFilling << 32;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    const unsigned slot = slotBase + i;
+
+    io_uring_sqe *sqe = NextSqe();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (unsigned long)jobs[i].path.c_str();
+    sqe->len = 0644;
+    // no O_CLOEXEC: the kernel rejects it for opens into a direct slot,
+    // which have no file descriptor to close on exec
+    sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+    sqe->file_index = slot + 1;
+    sqe->user_data = batchTag | i;
+
+    sqe = NextSqe();
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->flags = IOSQE_IO_LINK | IOSQE_FIXED_FILE;
+    sqe->fd = slot;
+    sqe->addr = (unsigned long)jobs[i].data.data();
+    sqe->len = jobs[i].data.size();
+    sqe->off = 0;
+    sqe->user_data = batchTag | i;
+
+    sqe = NextSqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = slot + 1;
+    sqe->user_data = batchTag | i;
+  }
+
+  const unsigned toSubmit = 3*jobs.size();
+  unsigned submitted = 0;
+  while (submitted < toSubmit) {
+    int ret = ioUringEnter(fRingFd, toSubmit - submitted, 0, 0);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // the kernel is short of resources or the completion queue is full:
+      // make room by reaping what this batch has completed, waiting for
+      // some if nothing has, rather than spinning
+      if ((errno == EAGAIN || errno == EBUSY) && fInFlight[fFilling] > 0) {
+        if (!Drain() && ioUringEnter(fRingFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR) {
+          std::cerr << "ERROR::WRITER::URING_WAIT_FAILED: " << strerror(errno) << std::endl;
+          break;
+        }
+        continue;
+      }
+      std::cerr << "ERROR::WRITER::URING_SUBMIT_FAILED: " << strerror(errno) << std::endl;
+      break;
+    }
+    submitted += ret;
+    fInFlight[fFilling] += ret;
+  }
+  if (submitted < toSubmit) {
+    // take back the entries the kernel did not consume, so that no later
+    // io_uring_enter submits them; Reap writes those jobs synchronously
+    __atomic_store_n(fSqTail, __atomic_load_n(fSqHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+  }
+  fSubmittedJobs[fFilling] = submitted / 3;
+  fFilling = other;
+}
+
+// wait for every completion of a submitted batch and release its buffers
+void UringFileWriter::Reap(int batch) {
+  std::vector<Job> &jobs = fBatches[batch];
+  if (jobs.empty() || batch == fFilling) {
+    return;
+  }
+  TRACE_SCOPE("uring_reap");
+
+  // only completions of entries that were submitted ever arrive
+  while (fInFlight[batch] > 0) {
+    if (Drain()) {
+      continue;
+    }
+    if (ioUringEnter(fRingFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+      // the kernel may still be reading the paths and buffers of this
+      // batch, so they can neither be freed nor reused
+      std::cerr << "ERROR::WRITER::URING_WAIT_FAILED: " << strerror(errno)
+                << "; cannot release in-flight buffers" << std::endl;
+      std::abort();
+    }
+  }
+
+  // retry failed chains synchronously so we report the real error, and
+  // write the jobs whose chains never (fully) made it into the ring
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    if (i < fSubmittedJobs[batch] && !fFailed[batch][i]) {
+      continue;
+    }
+    // a working ring should never get here, so say so once rather than
+    // letting the synchronous retry hide it
+    if (fFallbacks++ == 0) {
+      std::cerr << "ERROR::WRITER::URING_FALLBACK: '" << jobs[i].path << "' "
+                << (fChainError ? strerror(fChainError) : "was not submitted")
+                << "; writing such files synchronously" << std::endl;
+    }
+    if (!writeFileSync(jobs[i].path, jobs[i].data)) {
+      ++fErrors;
+    }
+  }
+  fPending -= jobs.size();
+  jobs.clear();
+  fFailed[batch].clear();
+  fSubmittedJobs[batch] = 0;
+}
+
+void UringFileWriter::Flush() {
+  if (!fBatches[fFilling].empty()) {
+    SubmitBatch();
+  }
+  Reap(1 - fFilling);
+}
+
+#endif // HAVE_IO_URING
+
+std::unique_ptr<FileWriter> FileWriter::Create(WriterBackend backend, int threads) {
+  switch (backend) {
+  case WriterBackend::SYNC:
+    return std::make_unique<SyncFileWriter>();
+  case WriterBackend::URING: {
+#ifdef HAVE_IO_URING
+    auto writer = std::make_unique<UringFileWriter>();
+    if (writer->Init()) {
+      return writer;
+    }
+    std::cerr << "io_uring unavailable (" << strerror(errno) << "), using thread pool writer" << std::endl;
+#else
+    std::cerr << "io_uring unsupported on this platform, using thread pool writer" << std::endl;
+#endif
+    return std::make_unique<ThreadPoolFileWriter>(threads);
+  }
+  case WriterBackend::THREADS:
+  default:
+    return std::make_unique<ThreadPoolFileWriter>(threads);
+  }
+}
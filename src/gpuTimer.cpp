@@ -0,0 +1,79 @@
+#include <cstdio>
+
+#include "gpuTimer.h"
+
+GpuTimer::GpuTimer(const std::vector<std::string> &stages, int latency)
+  : fStages(stages), fLatency(latency), fFrame(0), fActive(-1) {
+  const size_t numStages = fStages.size();
+  fQueries.resize(numStages*fLatency);
+  fIssued.assign(numStages*fLatency, false);
+  glGenQueries(fQueries.size(), fQueries.data());
+  fHistograms.assign(numStages, nullptr);
+  fTotals.assign(numStages, 0);
+  fCounts.assign(numStages, 0);
+}
+
+void GpuTimer::Destroy() {
+  if (!fQueries.empty()) {
+    glDeleteQueries(fQueries.size(), fQueries.data());
+    fQueries.clear();
+  }
+}
+
+void GpuTimer::Begin(int stage) {
+  End();
+  const int index = fFrame*fStages.size() + stage;
+  glBeginQuery(GL_TIME_ELAPSED, fQueries[index]);
+  fIssued[index] = true;
+  fActive = stage;
+}
+
+void GpuTimer::End() {
+  if (fActive >= 0) {
+    glEndQuery(GL_TIME_ELAPSED);
+    fActive = -1;
+  }
+}
+
+void GpuTimer::Collect(int frame) {
+  for (size_t stage = 0; stage < fStages.size(); ++stage) {
+    const int index = frame*fStages.size() + stage;
+    if (!fIssued[index]) {
+      continue;
+    }
+    GLuint64 elapsedNs = 0;
+    glGetQueryObjectui64v(fQueries[index], GL_QUERY_RESULT, &elapsedNs);
+    fIssued[index] = false;
+
+    const double seconds = elapsedNs * 1e-9;
+    fTotals[stage] += seconds;
+    ++fCounts[stage];
+    if (fHistograms[stage]) {
+      fHistograms[stage]->Observe(seconds);
+    }
+  }
+}
+
+void GpuTimer::NextFrame() {
+  End();
+  fFrame = (fFrame + 1) % fLatency;
+  Collect(fFrame);
+}
+
+void GpuTimer::Flush() {
+  End();
+  for (int frame = 0; frame < fLatency; ++frame) {
+    Collect(frame);
+  }
+}
+
+void GpuTimer::Report(std::ostream &out) const {
+  char buffer[128];
+  out << "GPU time per frame:\n";
+  for (size_t stage = 0; stage < fStages.size(); ++stage) {
+    const double mean = fCounts[stage] ? fTotals[stage] / fCounts[stage] : 0;
+    std::snprintf(buffer, sizeof(buffer), "  %-10s %9.1f us (%llu frames)\n", fStages[stage].c_str(),
+                  mean * 1e6, (unsigned long long)fCounts[stage]);
+    out << buffer;
+  }
+}
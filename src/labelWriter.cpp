@@ -0,0 +1,217 @@
+#include <cstring>
+#include <iostream>
+
+#include "labelWriter.h"
+
+constexpr uint32_t labelVersion = 1;
+
+// The columns of a record, in file order; the header and Append both walk
+// these tables, so a new column is a single entry. Values pass through a
+// double, which holds every int32 and float exactly.
+struct SampleColumn {
+  const char *name;
+  LabelType type;
+  double (*get)(const Sample&);
+};
+static const SampleColumn sampleColumns[] = {
+  {"index", LabelType::INT32, [](const Sample &s) -> double { return s.index; }},
+  {"angle", LabelType::FLOAT32, [](const Sample &s) -> double { return s.angle; }},
+  {"xDisp", LabelType::FLOAT32, [](const Sample &s) -> double { return s.xDisp; }},
+  {"yDisp", LabelType::FLOAT32, [](const Sample &s) -> double { return s.yDisp; }},
+  {"brightness", LabelType::FLOAT32, [](const Sample &s) -> double { return s.brightness; }},
+  {"contrast", LabelType::FLOAT32, [](const Sample &s) -> double { return s.contrast; }},
+  {"bgShade", LabelType::FLOAT32, [](const Sample &s) -> double { return s.bgShade; }},
+  {"bgType", LabelType::INT32, [](const Sample &s) -> double { return s.bgType; }},
+  {"bgAmplitude", LabelType::FLOAT32, [](const Sample &s) -> double { return s.bgAmplitude; }},
+  {"bgAngle", LabelType::FLOAT32, [](const Sample &s) -> double { return s.bgAngle; }},
+  {"bgScale", LabelType::FLOAT32, [](const Sample &s) -> double { return s.bgScale; }},
+  {"bgSeed", LabelType::INT32, [](const Sample &s) -> double { return s.bgSeed; }},
+  {"bgLayer", LabelType::INT32, [](const Sample &s) -> double { return s.bgLayer; }},
+  {"bgCropX", LabelType::INT32, [](const Sample &s) -> double { return s.bgCropX; }},
+  {"bgCropY", LabelType::INT32, [](const Sample &s) -> double { return s.bgCropY; }},
+  {"blurSigma", LabelType::FLOAT32, [](const Sample &s) -> double { return s.blurSigma; }},
+  {"shotCount", LabelType::FLOAT32, [](const Sample &s) -> double { return s.shotCount; }},
+  {"readNoise", LabelType::FLOAT32, [](const Sample &s) -> double { return s.readNoise; }},
+  {"jitter", LabelType::FLOAT32, [](const Sample &s) -> double { return s.jitter; }},
+  {"edgeGain", LabelType::FLOAT32, [](const Sample &s) -> double { return s.edgeGain; }},
+  {"noiseSeed", LabelType::INT32, [](const Sample &s) -> double { return s.noiseSeed; }},
+  {"gamma", LabelType::FLOAT32, [](const Sample &s) -> double { return s.gamma; }},
+  {"intensityOffset", LabelType::FLOAT32, [](const Sample &s) -> double { return s.intensityOffset; }},
+  {"saturation", LabelType::FLOAT32, [](const Sample &s) -> double { return s.saturation; }},
+};
+
+// repeated for each distractor, named distractor<i><name>
+struct DistractorColumn {
+  const char *name;
+  LabelType type;
+  double (*get)(const Distractor&);
+};
+static const DistractorColumn distractorColumns[] = {
+  {"X", LabelType::FLOAT32, [](const Distractor &d) -> double { return d.x; }},
+  {"Y", LabelType::FLOAT32, [](const Distractor &d) -> double { return d.y; }},
+  {"Radius", LabelType::FLOAT32, [](const Distractor &d) -> double { return d.radius; }},
+  {"Angle", LabelType::FLOAT32, [](const Distractor &d) -> double { return d.angle; }},
+  {"Sides", LabelType::INT32, [](const Distractor &d) -> double { return d.sides; }},
+  {"Shade", LabelType::FLOAT32, [](const Distractor &d) -> double { return d.shade; }},
+  {"Front", LabelType::INT32, [](const Distractor &d) -> double { return d.front; }},
+};
+
+LabelWriter::LabelWriter(const std::string &path, int distractors, int blockRows)
+  : fDistractors(distractors), fBlockRows(blockRows), fRows(0), fCsv(false), fOpen(false) {
+  fCsv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+
+  fFile.open(path, std::ios::binary | std::ios::trunc);
+  if (!fFile) {
+    std::cerr << "ERROR::LABELS::FAILED_TO_OPEN: '" << path << "'" << std::endl;
+    return;
+  }
+  fOpen = true;
+
+  for (const SampleColumn &column : sampleColumns) {
+    AddColumn(column.name, column.type);
+  }
+  for (int i = 0; i < fDistractors; ++i) {
+    for (const DistractorColumn &column : distractorColumns) {
+      AddColumn("distractor" + std::to_string(i) + column.name, column.type);
+    }
+  }
+  AddColumn("path", LabelType::STRING);
+  WriteHeader();
+}
+
+void LabelWriter::AddColumn(const std::string &name, LabelType type) {
+  Column column;
+  column.name = name;
+  column.type = type;
+  fColumns.push_back(column);
+}
+
+void LabelWriter::WriteHeader() {
+  if (fCsv) {
+    for (size_t i = 0; i < fColumns.size(); ++i) {
+      fCsvBuffer += (i ? "," : "") + fColumns[i].name;
+    }
+    fCsvBuffer += "\n";
+    return;
+  }
+
+  const uint32_t numColumns = fColumns.size();
+  fFile.write("RLBL", 4);
+  fFile.write((const char*)&labelVersion, sizeof(labelVersion));
+  fFile.write((const char*)&numColumns, sizeof(numColumns));
+  for (const Column &column : fColumns) {
+    const uint8_t type = (uint8_t)column.type;
+    const uint8_t nameLen = column.name.size();
+    fFile.write((const char*)&type, 1);
+    fFile.write((const char*)&nameLen, 1);
+    fFile.write(column.name.data(), nameLen);
+  }
+}
+
+void LabelWriter::PushInt(int column, int32_t value) {
+  if (fCsv) {
+    fCsvBuffer += (column ? "," : "") + std::to_string(value);
+    return;
+  }
+  std::vector<char> &data = fColumns[column].data;
+  data.insert(data.end(), (const char*)&value, (const char*)&value + sizeof(value));
+}
+
+void LabelWriter::PushFloat(int column, float value) {
+  if (fCsv) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%s%.9g", column ? "," : "", value);
+    fCsvBuffer += buffer;
+    return;
+  }
+  std::vector<char> &data = fColumns[column].data;
+  data.insert(data.end(), (const char*)&value, (const char*)&value + sizeof(value));
+}
+
+void LabelWriter::PushValue(int column, LabelType type, double value) {
+  if (type == LabelType::INT32) {
+    PushInt(column, (int32_t)(int64_t)value);
+  } else {
+    PushFloat(column, (float)value);
+  }
+}
+
+void LabelWriter::PushString(int column, const std::string &value) {
+  if (fCsv) {
+    // quote everything so paths containing commas survive
+    fCsvBuffer += column ? ",\"" : "\"";
+    for (char c : value) {
+      fCsvBuffer += c;
+      if (c == '"') {
+        fCsvBuffer += '"';
+      }
+    }
+    fCsvBuffer += "\"";
+    return;
+  }
+  Column &col = fColumns[column];
+  if (col.offsets.empty()) {
+    col.offsets.push_back(0);
+  }
+  col.data.insert(col.data.end(), value.begin(), value.end());
+  col.offsets.push_back(col.data.size());
+}
+
+void LabelWriter::Append(const Sample &sample) {
+  if (!fOpen) {
+    return;
+  }
+  int column = 0;
+  for (const SampleColumn &scalar : sampleColumns) {
+    PushValue(column++, scalar.type, scalar.get(sample));
+  }
+  for (int i = 0; i < fDistractors; ++i) {
+    // samples with fewer distractors get zero-sided placeholders
+    const Distractor none = {0, 0, 0, 0, 0, 0, false};
+    const Distractor &distractor = i < (int)sample.distractors.size() ? sample.distractors[i] : none;
+    for (const DistractorColumn &scalar : distractorColumns) {
+      PushValue(column++, scalar.type, scalar.get(distractor));
+    }
+  }
+  PushString(column, sample.path);
+  if (fCsv) {
+    fCsvBuffer += "\n";
+  }
+
+  if (++fRows >= fBlockRows) {
+    FlushBlock();
+  }
+}
+
+void LabelWriter::FlushBlock() {
+  if (fCsv) {
+    fFile.write(fCsvBuffer.data(), fCsvBuffer.size());
+    fCsvBuffer.clear();
+    fRows = 0;
+    return;
+  }
+  if (fRows == 0) {
+    return;
+  }
+
+  const uint32_t numRows = fRows;
+  fFile.write((const char*)&numRows, sizeof(numRows));
+  for (Column &column : fColumns) {
+    if (column.type == LabelType::STRING) {
+      fFile.write((const char*)column.offsets.data(), column.offsets.size()*sizeof(uint32_t));
+      column.offsets.clear();
+    }
+    fFile.write(column.data.data(), column.data.size());
+    column.data.clear();
+  }
+  fRows = 0;
+}
+
+void LabelWriter::Close() {
+  if (!fOpen) {
+    return;
+  }
+  FlushBlock();
+  fFile.close();
+  fOpen = false;
+}
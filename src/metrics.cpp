@@ -0,0 +1,123 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include "metrics.h"
+
+void Histogram::Observe(double seconds) {
+  int bucket = 0;
+  if (seconds > METRICS_MIN_BUCKET_S) {
+    bucket = std::ceil(std::log2(seconds / METRICS_MIN_BUCKET_S));
+  }
+  // the last bucket doubles as +Inf
+  if (bucket >= METRICS_BUCKETS) {
+    bucket = METRICS_BUCKETS - 1;
+  }
+  fBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  fCount.fetch_add(1, std::memory_order_relaxed);
+  fSumNs.fetch_add((uint64_t)(seconds * 1e9), std::memory_order_relaxed);
+}
+
+double Histogram::Bound(int bucket) const {
+  return METRICS_MIN_BUCKET_S * std::ldexp(1.0, bucket);
+}
+
+Metrics::Metrics(const std::string &prefix)
+  : fPrefix(prefix), fIntervalMs(METRICS_INTERVAL_MS), fStopping(false) {}
+
+Counter &Metrics::AddCounter(const std::string &name, const std::string &help) {
+  fCounters.emplace_back();
+  fEntries.push_back(Entry{fPrefix + "_" + name, help, &fCounters.back(), nullptr, nullptr});
+  return fCounters.back();
+}
+
+Histogram &Metrics::AddHistogram(const std::string &name, const std::string &help) {
+  fHistograms.emplace_back();
+  fEntries.push_back(Entry{fPrefix + "_" + name, help, nullptr, nullptr, &fHistograms.back()});
+  return fHistograms.back();
+}
+
+Gauge &Metrics::AddGauge(const std::string &name, const std::string &help) {
+  fGauges.emplace_back();
+  fEntries.push_back(Entry{fPrefix + "_" + name, help, nullptr, &fGauges.back(), nullptr});
+  return fGauges.back();
+}
+
+std::string Metrics::Format() const {
+  std::string out;
+  char buffer[256];
+  for (const Entry &entry : fEntries) {
+    const char *type = entry.counter ? "counter" : entry.histogram ? "histogram" : "gauge";
+    out += "# HELP " + entry.name + " " + entry.help + "\n";
+    out += "# TYPE " + entry.name + " " + type + "\n";
+    if (entry.counter) {
+      std::snprintf(buffer, sizeof(buffer), "%s %llu\n", entry.name.c_str(),
+                    (unsigned long long)entry.counter->Value());
+      out += buffer;
+    } else if (entry.histogram) {
+      const Histogram &histogram = *entry.histogram;
+      uint64_t cumulative = 0;
+      for (int i = 0; i < METRICS_BUCKETS - 1; ++i) {
+        cumulative += histogram.BucketCount(i);
+        std::snprintf(buffer, sizeof(buffer), "%s_bucket{le=\"%g\"} %llu\n", entry.name.c_str(),
+                      histogram.Bound(i), (unsigned long long)cumulative);
+        out += buffer;
+      }
+      // take the total from the buckets so it is consistent with them
+      cumulative += histogram.BucketCount(METRICS_BUCKETS - 1);
+      std::snprintf(buffer, sizeof(buffer), "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9g\n%s_count %llu\n",
+                    entry.name.c_str(), (unsigned long long)cumulative,
+                    entry.name.c_str(), histogram.Sum(),
+                    entry.name.c_str(), (unsigned long long)cumulative);
+      out += buffer;
+    } else {
+      std::snprintf(buffer, sizeof(buffer), "%s %.9g\n", entry.name.c_str(), entry.gauge->Value());
+      out += buffer;
+    }
+  }
+  return out;
+}
+
+void Metrics::Write() {
+  const std::string text = Format();
+  const std::string tmpPath = fPath + ".tmp";
+  FILE *file = fopen(tmpPath.c_str(), "w");
+  if (!file) {
+    std::cerr << "ERROR::METRICS::FAILED_TO_OPEN: '" << tmpPath << "'" << std::endl;
+    return;
+  }
+  fwrite(text.data(), 1, text.size(), file);
+  if (fclose(file) != 0 || std::rename(tmpPath.c_str(), fPath.c_str()) != 0) {
+    std::cerr << "ERROR::METRICS::FAILED_TO_WRITE: '" << fPath << "'" << std::endl;
+  }
+}
+
+void Metrics::Start(const std::string &path, double intervalMs) {
+  if (fThread.joinable()) {
+    return;
+  }
+  fPath = path;
+  fIntervalMs = intervalMs;
+  fStopping = false;
+  fThread = std::thread(&Metrics::Run, this);
+}
+
+void Metrics::Run() {
+  const auto interval = std::chrono::duration<double, std::milli>(fIntervalMs);
+  std::unique_lock<std::mutex> lock(fMutex);
+  do {
+    Write();
+  } while (!fWake.wait_for(lock, interval, [this] { return fStopping; }));
+  Write();
+}
+
+void Metrics::Stop() {
+  if (fThread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fStopping = true;
+    }
+    fWake.notify_all();
+    fThread.join();
+  }
+}
@@ -0,0 +1,273 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "options.h"
+
+std::string defaultShaderCacheDir() {
+  const char *cache = getenv("XDG_CACHE_HOME");
+  if (cache && *cache) {
+    return std::string(cache) + "/2d_rot_generator/shaders";
+  }
+  const char *home = getenv("HOME");
+  if (home && *home) {
+    return std::string(home) + "/.cache/2d_rot_generator/shaders";
+  }
+  return "";
+}
+
+static void printUsage(const char *prog) {
+  std::cerr << "usage: " << prog << " [options]\n"
+            << "  --fanout N    spread images over N levels of hashed subdirectories (0-3, default 0)\n"
+            << "  --format F    image format: png, pgm, ppm, npy or npy-batch (default png)\n"
+            << "  --channels N  channels stored by the npy formats, 1 or 3 (default 1)\n"
+            << "  --preview-interval MS  minimum time between preview frames (default 100)\n"
+            << "  --no-preview  do not show generated frames in the window\n"
+            << "  --progress P  progress output: bar (stderr) or json (JSON lines on stdout)\n"
+            << "  --progress-interval MS  minimum time between progress updates (default 200)\n"
+            << "  --metrics FILE  periodically write Prometheus text format metrics to FILE\n"
+            << "  --metrics-interval MS  time between metrics writes (default 5000)\n"
+            << "  --shader-cache DIR  cache linked shader programs in DIR\n"
+            << "                (default $XDG_CACHE_HOME/2d_rot_generator/shaders)\n"
+            << "  --no-shader-cache  always compile shaders from source\n"
+            << "  --background B  background: flat, gradient, noise (value noise), image\n"
+            << "                or mixed (a random one per sample; default flat)\n"
+            << "  --background-dir DIR  images used by the image background\n"
+            << "  --transfer    apply a random gamma, offset and saturation to each frame\n"
+            << "  --distractors K  draw K random polygons around the triangle (default 0)\n"
+            << "  --blur        blur frames with a Gaussian of random width (beam focus)\n"
+            << "  --noise       add SEM detector noise, scan-line jitter and edge brightening\n"
+            << "  --labels L    label sidecar format: bin (columnar, default) or csv\n"
+            << "  --gpu-timers  measure GPU time of the clear, draw, post and readback stages\n"
+            << "  --trace FILE  record a Chrome trace of the pipeline stages to FILE\n"
+            << "                (needs a build with -DENABLE_TRACING=ON)\n"
+            << "  --seed S      random seed (default 1)\n"
+            << "  --writer W    file output backend: sync, threads or uring (default uring,\n"
+            << "                falls back to threads when io_uring is unavailable)\n"
+            << "  --writer-threads N  threads used by the thread pool writer (default 4)\n"
+            << "  --help        show this message\n";
+}
+
+// fetch the value of an option taking an argument
+static const char *optionValue(int argc, char **argv, int &i) {
+  if (i + 1 >= argc) {
+    std::cerr << "option '" << argv[i] << "' requires a value" << std::endl;
+    return nullptr;
+  }
+  return argv[++i];
+}
+
+ParseResult parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (!strcmp(arg, "--help") || !strcmp(arg, "-h")) {
+      printUsage(argv[0]);
+      return ParseResult::EXIT;
+    } else if (!strcmp(arg, "--fanout")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.fanoutLevels = atoi(value);
+      if (options.fanoutLevels < 0 || options.fanoutLevels > 3) {
+        std::cerr << "--fanout must be between 0 and 3" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--format")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      if (!strcmp(value, "png")) {
+        options.format = ImageFormat::PNG;
+      } else if (!strcmp(value, "pgm")) {
+        options.format = ImageFormat::PGM;
+      } else if (!strcmp(value, "ppm")) {
+        options.format = ImageFormat::PPM;
+      } else if (!strcmp(value, "npy")) {
+        options.format = ImageFormat::NPY;
+      } else if (!strcmp(value, "npy-batch")) {
+        options.format = ImageFormat::NPY_BATCH;
+      } else {
+        std::cerr << "unknown format '" << value << "'" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--channels")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.channels = atoi(value);
+      if (options.channels != 1 && options.channels != 3) {
+        std::cerr << "--channels must be 1 or 3" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--preview-interval")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.previewIntervalMs = atof(value);
+      if (!(options.previewIntervalMs > 0)) {
+        std::cerr << "--preview-interval must be positive" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--no-preview")) {
+      options.preview = false;
+    } else if (!strcmp(arg, "--progress")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      if (!strcmp(value, "bar")) {
+        options.progressMode = ProgressMode::BAR;
+      } else if (!strcmp(value, "json")) {
+        options.progressMode = ProgressMode::JSON;
+      } else {
+        std::cerr << "unknown progress mode '" << value << "'" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--labels")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      if (!strcmp(value, "bin")) {
+        options.csvLabels = false;
+      } else if (!strcmp(value, "csv")) {
+        options.csvLabels = true;
+      } else {
+        std::cerr << "unknown label format '" << value << "'" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--progress-interval")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.progressIntervalMs = atof(value);
+      if (!(options.progressIntervalMs > 0)) {
+        std::cerr << "--progress-interval must be positive" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--metrics")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.metricsPath = value;
+    } else if (!strcmp(arg, "--metrics-interval")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.metricsIntervalMs = atof(value);
+      if (!(options.metricsIntervalMs > 0)) {
+        std::cerr << "--metrics-interval must be positive" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--shader-cache")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.shaderCacheDir = value;
+    } else if (!strcmp(arg, "--no-shader-cache")) {
+      options.shaderCacheDir.clear();
+    } else if (!strcmp(arg, "--background")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      if (!strcmp(value, "flat")) {
+        options.background = BackgroundType::FLAT;
+      } else if (!strcmp(value, "gradient")) {
+        options.background = BackgroundType::GRADIENT;
+      } else if (!strcmp(value, "noise")) {
+        options.background = BackgroundType::NOISE;
+      } else if (!strcmp(value, "image")) {
+        options.background = BackgroundType::IMAGE;
+      } else if (!strcmp(value, "mixed")) {
+        options.background = BackgroundType::MIXED;
+      } else {
+        std::cerr << "unknown background '" << value << "'" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--background-dir")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.backgroundDir = value;
+    } else if (!strcmp(arg, "--transfer")) {
+      options.transfer = true;
+    } else if (!strcmp(arg, "--distractors")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.distractors = atoi(value);
+      if (options.distractors < 0) {
+        std::cerr << "--distractors must not be negative" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--blur")) {
+      options.blur = true;
+    } else if (!strcmp(arg, "--noise")) {
+      options.noise = true;
+    } else if (!strcmp(arg, "--gpu-timers")) {
+      options.gpuTimers = true;
+    } else if (!strcmp(arg, "--trace")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.tracePath = value;
+    } else if (!strcmp(arg, "--seed")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.seed = strtoul(value, nullptr, 10);
+    } else if (!strcmp(arg, "--writer")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      if (!strcmp(value, "sync")) {
+        options.writerBackend = WriterBackend::SYNC;
+      } else if (!strcmp(value, "threads")) {
+        options.writerBackend = WriterBackend::THREADS;
+      } else if (!strcmp(value, "uring")) {
+        options.writerBackend = WriterBackend::URING;
+      } else {
+        std::cerr << "unknown writer '" << value << "'" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else if (!strcmp(arg, "--writer-threads")) {
+      const char *value = optionValue(argc, argv, i);
+      if (!value) {
+        return ParseResult::ERROR;
+      }
+      options.writerThreads = atoi(value);
+      if (options.writerThreads < 1) {
+        std::cerr << "--writer-threads must be at least 1" << std::endl;
+        return ParseResult::ERROR;
+      }
+    } else {
+      std::cerr << "unknown option '" << arg << "'" << std::endl;
+      printUsage(argv[0]);
+      return ParseResult::ERROR;
+    }
+  }
+  if (options.background == BackgroundType::IMAGE && options.backgroundDir.empty()) {
+    std::cerr << "--background image needs --background-dir" << std::endl;
+    return ParseResult::ERROR;
+  }
+  if (!options.backgroundDir.empty() && options.background != BackgroundType::IMAGE &&
+      options.background != BackgroundType::MIXED) {
+    std::cerr << "--background-dir is only used by --background image or mixed" << std::endl;
+    return ParseResult::ERROR;
+  }
+  return ParseResult::RUN;
+}
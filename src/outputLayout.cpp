@@ -0,0 +1,57 @@
+#include <cstdint>
+#include <iostream>
+
+#include "outputLayout.h"
+
+// FNV-1a; cheap and spreads similar file names well
+static uint32_t hashName(const std::string &name) {
+  uint32_t hash = 2166136261u;
+  for (unsigned char c : name) {
+    hash ^= c;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+OutputLayout::OutputLayout(const std::filesystem::path &root, int levels,
+                           const std::string &indexName)
+  : fRoot(root), fLevels(levels) {
+  fIndex.open(fRoot / indexName, std::ios::trunc);
+  if (!fIndex) {
+    std::cerr << "ERROR::LAYOUT::FAILED_TO_OPEN_INDEX: '" << (fRoot / indexName).string() << "'" << std::endl;
+  }
+}
+
+std::filesystem::path OutputLayout::Place(const std::string &fileName) {
+  std::filesystem::path relative;
+  if (fLevels > 0) {
+    const uint32_t hash = hashName(fileName);
+    std::string dir;
+    for (int level = 0; level < fLevels; ++level) {
+      char part[4];
+      std::snprintf(part, sizeof(part), "%02x/", (hash >> (8*level)) & 0xff);
+      dir += part;
+    }
+    if (fCreated.insert(dir).second) {
+      std::error_code ec;
+      std::filesystem::create_directories(fRoot / dir, ec);
+      if (ec) {
+        std::cerr << "ERROR::LAYOUT::FAILED_TO_CREATE_DIR: '" << (fRoot / dir).string() << "'; " << ec.message() << std::endl;
+      }
+    }
+    relative = std::filesystem::path(dir) / fileName;
+  } else {
+    relative = fileName;
+  }
+
+  if (fIndex) {
+    fIndex << fileName << '\t' << relative.string() << '\n';
+  }
+  return relative;
+}
+
+void OutputLayout::Close() {
+  if (fIndex.is_open()) {
+    fIndex.close();
+  }
+}
@@ -0,0 +1,311 @@
+#include <cstdint>
+#include <cstring>
+
+#include "pngEncoder.h"
+
+constexpr int maxPalette = PNG_MAX_PALETTE;
+
+/* checksums */
+
+struct CrcTable {
+  uint32_t entries[256];
+  CrcTable() {
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      entries[n] = c;
+    }
+  }
+};
+
+static uint32_t crc32(uint32_t crc, const unsigned char *data, size_t len) {
+  static const CrcTable table;
+  const uint32_t *crcTable = table.entries;
+  crc = ~crc;
+  for (size_t i = 0; i < len; ++i) {
+    crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static uint32_t adler32(const unsigned char *data, size_t len) {
+  uint32_t a = 1;
+  uint32_t b = 0;
+  while (len > 0) {
+    // largest block before b can overflow
+    size_t block = len < 5552 ? len : 5552;
+    len -= block;
+    while (block--) {
+      a += *data++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return (b << 16) | a;
+}
+
+/* fixed-Huffman deflate */
+
+static const uint16_t lengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+class BitWriter {
+public:
+  BitWriter(std::vector<unsigned char> &out) : fOut(out), fBits(0), fCount(0) {}
+  // append the low n bits of value, least significant first
+  void Put(uint32_t value, int n) {
+    fBits |= (uint64_t)value << fCount;
+    fCount += n;
+    while (fCount >= 8) {
+      fOut.push_back(fBits & 0xff);
+      fBits >>= 8;
+      fCount -= 8;
+    }
+  }
+  // append a Huffman code, which deflate stores most significant bit first
+  void PutCode(uint32_t code, int n) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < n; ++i) {
+      reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    Put(reversed, n);
+  }
+  void Finish() {
+    if (fCount > 0) {
+      fOut.push_back(fBits & 0xff);
+    }
+    fBits = 0;
+    fCount = 0;
+  }
+
+private:
+  std::vector<unsigned char> &fOut;
+  uint64_t fBits;
+  int fCount;
+};
+
+static void putLiteral(BitWriter &bits, int symbol) {
+  if (symbol < 144) {
+    bits.PutCode(0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    bits.PutCode(0x190 + symbol - 144, 9);
+  } else if (symbol < 280) {
+    bits.PutCode(symbol - 256, 7);
+  } else {
+    bits.PutCode(0xc0 + symbol - 280, 8);
+  }
+}
+
+static void putMatch(BitWriter &bits, int length, int distance) {
+  int code = 28;
+  while (lengthBase[code] > length) {
+    --code;
+  }
+  putLiteral(bits, 257 + code);
+  bits.Put(length - lengthBase[code], lengthExtra[code]);
+
+  code = 29;
+  while (distBase[code] > distance) {
+    --code;
+  }
+  bits.PutCode(code, 5);
+  bits.Put(distance - distBase[code], distExtra[code]);
+}
+
+// Compress data as a zlib stream. The only matches considered are a run of
+// the previous byte and a repeat of the previous row, which is cheap and
+// catches almost everything in a flat-shaded image.
+static void deflateRows(std::vector<unsigned char> &out, const unsigned char *data,
+                        size_t len, size_t rowLen) {
+  out.push_back(0x78); // deflate, 32K window
+  out.push_back(0x01); // fastest compression
+  BitWriter bits(out);
+  bits.Put(1, 1); // final block
+  bits.Put(1, 2); // fixed Huffman codes
+
+  size_t i = 0;
+  while (i < len) {
+    const size_t maxLen = len - i < 258 ? len - i : 258;
+    size_t bestLen = 0;
+    size_t bestDist = 0;
+    const size_t dists[2] = {rowLen, 1};
+    for (size_t distance : dists) {
+      if (distance > i || distance > 32768) {
+        continue;
+      }
+      const unsigned char *a = data + i;
+      const unsigned char *b = a - distance;
+      size_t n = 0;
+      while (n < maxLen && a[n] == b[n]) {
+        ++n;
+      }
+      if (n > bestLen) {
+        bestLen = n;
+        bestDist = distance;
+      }
+    }
+    if (bestLen >= 3) {
+      putMatch(bits, bestLen, bestDist);
+      i += bestLen;
+    } else {
+      putLiteral(bits, data[i]);
+      ++i;
+    }
+  }
+  putLiteral(bits, 256); // end of block
+  bits.Finish();
+
+  const uint32_t adler = adler32(data, len);
+  out.push_back(adler >> 24);
+  out.push_back(adler >> 16);
+  out.push_back(adler >> 8);
+  out.push_back(adler);
+}
+
+/* PNG container */
+
+static void putU32(std::vector<unsigned char> &out, uint32_t value) {
+  out.push_back(value >> 24);
+  out.push_back(value >> 16);
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+// wrap the bytes from start onwards, which follow a placeholder length and
+// the chunk type, into a complete chunk
+static void finishChunk(std::vector<unsigned char> &out, size_t start) {
+  const uint32_t length = out.size() - start - 8;
+  out[start] = length >> 24;
+  out[start + 1] = length >> 16;
+  out[start + 2] = length >> 8;
+  out[start + 3] = length;
+  putU32(out, crc32(0, &out[start + 4], length + 4));
+}
+
+static size_t beginChunk(std::vector<unsigned char> &out, const char type[4]) {
+  const size_t start = out.size();
+  putU32(out, 0);
+  out.insert(out.end(), type, type + 4);
+  return start;
+}
+
+static void putText(std::vector<unsigned char> &out, const std::vector<PngText> &text) {
+  for (const PngText &entry : text) {
+    const size_t chunk = beginChunk(out, "tEXt");
+    out.insert(out.end(), entry.keyword.begin(), entry.keyword.end());
+    out.push_back(0);
+    out.insert(out.end(), entry.text.begin(), entry.text.end());
+    finishChunk(out, chunk);
+  }
+}
+
+void insertPngText(std::vector<unsigned char> &png, const std::vector<PngText> &text) {
+  // signature (8) + IHDR length, type, data and crc (4 + 4 + 13 + 4)
+  constexpr size_t afterIhdr = 33;
+  if (text.empty() || png.size() < afterIhdr) {
+    return;
+  }
+  std::vector<unsigned char> chunks;
+  putText(chunks, text);
+  png.insert(png.begin() + afterIhdr, chunks.begin(), chunks.end());
+}
+
+bool encodePalettePng(std::vector<unsigned char> &out, const unsigned char *rgb,
+                      int width, int height, int stride,
+                      const std::vector<PngText> &text) {
+  // find the palette, remembering the last hit as the next pixel almost
+  // always shares it
+  uint32_t palette[maxPalette];
+  int numColours = 0;
+  int last = 0;
+  for (int y = 0; y < height; ++y) {
+    const unsigned char *row = rgb + (size_t)y*stride;
+    for (int x = 0; x < width; ++x) {
+      const uint32_t colour = row[3*x] | (row[3*x + 1] << 8) | (row[3*x + 2] << 16);
+      if (numColours && palette[last] == colour) {
+        continue;
+      }
+      int i = 0;
+      while (i < numColours && palette[i] != colour) {
+        ++i;
+      }
+      if (i == numColours) {
+        if (numColours == maxPalette) {
+          return false;
+        }
+        palette[numColours++] = colour;
+      }
+      last = i;
+    }
+  }
+
+  const int depth = numColours <= 2 ? 1 : numColours <= 4 ? 2 : 4;
+  const int perByte = 8 / depth;
+  const size_t rowLen = 1 + (width + perByte - 1) / perByte;
+
+  // pack indices behind a "none" filter byte per row
+  std::vector<unsigned char> raw(rowLen*height, 0);
+  for (int y = 0; y < height; ++y) {
+    const unsigned char *row = rgb + (size_t)y*stride;
+    unsigned char *dst = &raw[y*rowLen + 1];
+    int index = 0;
+    for (int x = 0; x < width; ++x) {
+      const uint32_t colour = row[3*x] | (row[3*x + 1] << 8) | (row[3*x + 2] << 16);
+      if (palette[index] != colour) {
+        index = 0;
+        while (palette[index] != colour) {
+          ++index;
+        }
+      }
+      dst[x / perByte] |= index << (8 - depth*(x % perByte + 1));
+    }
+  }
+
+  static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  out.insert(out.end(), signature, signature + 8);
+
+  size_t chunk = beginChunk(out, "IHDR");
+  putU32(out, width);
+  putU32(out, height);
+  out.push_back(depth);
+  out.push_back(3); // palette colour type
+  out.push_back(0); // deflate
+  out.push_back(0); // adaptive filtering
+  out.push_back(0); // not interlaced
+  finishChunk(out, chunk);
+
+  chunk = beginChunk(out, "PLTE");
+  for (int i = 0; i < numColours; ++i) {
+    out.push_back(palette[i] & 0xff);
+    out.push_back((palette[i] >> 8) & 0xff);
+    out.push_back((palette[i] >> 16) & 0xff);
+  }
+  finishChunk(out, chunk);
+
+  putText(out, text);
+
+  chunk = beginChunk(out, "IDAT");
+  deflateRows(out, raw.data(), raw.size(), rowLen);
+  finishChunk(out, chunk);
+
+  chunk = beginChunk(out, "IEND");
+  finishChunk(out, chunk);
+  return true;
+}
@@ -0,0 +1,82 @@
+#include "postProcess.h"
+#include "embeddedShaders.h"
+
+// features of the last pass
+enum FinalFeature {
+  FINAL_DETECTOR = 1 << 0,
+  FINAL_TRANSFER = 1 << 1
+};
+
+PostProcess::PostProcess(int width, int height)
+  : fScratch(width, height), fVAO(0),
+    fBlurShader(Shader::FromSource, fullscreenVertShaderSrc, gaussBlurFragShaderSrc, "gaussBlur"),
+    fFinalShaders(fullscreenVertShaderSrc, detectorFragShaderSrc, {"DETECTOR", "TRANSFER"},
+                  "detector"),
+    fBlur(false), fDetector(false), fTransfer(false) {
+  // the full-screen triangle comes from gl_VertexID, but the core profile
+  // still wants a vertex array bound to draw
+  glGenVertexArrays(1, &fVAO);
+}
+
+void PostProcess::Destroy() {
+  if (fVAO) {
+    glDeleteVertexArrays(1, &fVAO);
+    glDeleteProgram(fBlurShader.ID);
+    fFinalShaders.Destroy();
+    fVAO = 0;
+  }
+  fScratch.Destroy();
+}
+
+void PostProcess::Pass(RenderTarget &from, RenderTarget &to) {
+  to.Bind();
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, from.Texture());
+  glBindVertexArray(fVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+RenderTarget &PostProcess::Apply(RenderTarget &frame, const Sample &sample) {
+  RenderTarget *current = &frame;
+  // the target the next pass writes to
+  auto next = [&]() -> RenderTarget& {
+    return current == &frame ? fScratch : frame;
+  };
+
+  if (fBlur && sample.blurSigma > 0) {
+    fBlurShader.use();
+    fBlurShader.setInt("frame", 0);
+    fBlurShader.setFloat("sigma", sample.blurSigma);
+    // horizontal then vertical, which together make the 2D kernel
+    const float directions[2][2] = {{1, 0}, {0, 1}};
+    for (const float *direction : directions) {
+      RenderTarget &out = next();
+      fBlurShader.set2Vec("direction", direction[0], direction[1]);
+      Pass(*current, out);
+      current = &out;
+    }
+  }
+
+  const unsigned features = (fDetector ? FINAL_DETECTOR : 0) | (fTransfer ? FINAL_TRANSFER : 0);
+  if (features) {
+    RenderTarget &out = next();
+    Shader &shader = fFinalShaders.Get(features);
+    shader.use();
+    shader.setInt("frame", 0);
+    if (fDetector) {
+      shader.setUInt("seed", sample.noiseSeed);
+      shader.setFloat("shotCount", sample.shotCount);
+      shader.setFloat("readNoise", sample.readNoise);
+      shader.setFloat("jitter", sample.jitter);
+      shader.setFloat("edgeGain", sample.edgeGain);
+    }
+    if (fTransfer) {
+      shader.setFloat("gamma", sample.gamma);
+      shader.setFloat("intensityOffset", sample.intensityOffset);
+      shader.setFloat("saturation", sample.saturation);
+    }
+    Pass(*current, out);
+    current = &out;
+  }
+  return *current;
+}
@@ -1,31 +1,114 @@
-#include <iostream>
+#include <cstdio>
 #include "progressBar.h"
 
 ProgressBar::ProgressBar(int length, double min, double max)
-  : fValue(min), fMin(min), fMax(max), fLength(length), fShowRaw(false) {}
+  : ProgressBar(length, min, max, false) {}
 
 ProgressBar::ProgressBar(int length, double min, double max, bool showRaw)
-  : fValue(min), fMin(min), fMax(max), fLength(length), fShowRaw(showRaw) {}
+  : fMin(min), fMax(max), fLength(length), fShowRaw(showRaw),
+    fMode(ProgressMode::BAR), fIntervalMs(PROGRESS_INTERVAL_MS),
+    fStart(std::chrono::steady_clock::now()), fRedraw(PROGRESS_INTERVAL_MS),
+    fStopping(false) {}
+
+ProgressBar::Slot &ProgressBar::LocalSlot() {
+  // threads take slots round-robin the first time they count anything
+  static std::atomic<unsigned> nextSlot(0);
+  thread_local unsigned slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % PROGRESS_SLOTS;
+  return fSlots[slot];
+}
+
+void ProgressBar::SetMode(ProgressMode mode, const std::string &label) {
+  fMode = mode;
+  fLabel = label;
+}
+
+void ProgressBar::SetInterval(double intervalMs) {
+  fIntervalMs = intervalMs;
+  fRedraw = RateLimiter(intervalMs);
+}
 
 void ProgressBar::Display() {
-  using namespace std;
+  if (fRedraw.Ready()) {
+    Render(false);
+  }
+}
 
-  const double percentage = (fValue - fMin) / (fMax - fMin);
+void ProgressBar::Start() {
+  if (!fReporter.joinable()) {
+    fStopping = false;
+    fReporter = std::thread(&ProgressBar::Report, this);
+  }
+}
 
-  const int numFilled = fLength * percentage;
-  const int numEmpty = fLength - numFilled;
+void ProgressBar::Report() {
+  const auto interval = std::chrono::duration<double, std::milli>(fIntervalMs);
+  std::unique_lock<std::mutex> lock(fMutex);
+  while (!fWake.wait_for(lock, interval, [this] { return fStopping; })) {
+    Render(false);
+  }
+}
 
-  cerr << "\r";
-  for (int i = 0; i < numFilled; ++i) {
-    cerr << "#";
+void ProgressBar::Stop() {
+  if (fReporter.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fStopping = true;
+    }
+    fWake.notify_all();
+    fReporter.join();
   }
-  for (int i = 0; i < numEmpty; ++i) {
-    cerr << "-";
+}
+
+void ProgressBar::Finish() {
+  Stop();
+  Render(true);
+}
+
+// build the whole line first so each redraw is a single write
+void ProgressBar::Render(bool final) {
+  double done = 0;
+  double bytes = 0;
+  for (const Slot &slot : fSlots) {
+    done += slot.value.load(std::memory_order_relaxed);
+    bytes += slot.bytes.load(std::memory_order_relaxed);
   }
+  const double total = fMax - fMin;
+  const double percentage = total > 0 ? done / total : 1;
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - fStart).count();
+  const double rate = elapsed > 0 ? done / elapsed : 0;
+  const double mbRate = elapsed > 0 ? bytes / elapsed / 1e6 : 0;
+  const double eta = rate > 0 ? (total - done) / rate : 0;
 
+  char buffer[256];
+  std::string line;
+  if (fMode == ProgressMode::JSON) {
+    std::snprintf(buffer, sizeof(buffer),
+                  "{\"stage\":\"%s\",\"done\":%.0f,\"total\":%.0f,\"elapsed_s\":%.3f,"
+                  "\"images_per_s\":%.2f,\"mb_per_s\":%.3f,\"eta_s\":%.1f,\"final\":%s}\n",
+                  fLabel.c_str(), done, total, elapsed, rate, mbRate, eta,
+                  final ? "true" : "false");
+    line = buffer;
+    fwrite(line.data(), 1, line.size(), stdout);
+    fflush(stdout);
+    return;
+  }
+
+  const int numFilled = fLength * percentage;
+  const int numEmpty = fLength - numFilled;
+  line = "\r";
+  line.append(numFilled, '#');
+  line.append(numEmpty, '-');
   if (fShowRaw) {
-    cerr << " (" << fValue << "/" << fMax - fMin << ")";
+    std::snprintf(buffer, sizeof(buffer), " (%g/%g)", done, total);
+    line += buffer;
+  }
+  const int etaSeconds = eta + 0.5;
+  std::snprintf(buffer, sizeof(buffer), " %.1f img/s %.2f MB/s ETA %d:%02d ",
+                rate, mbRate, etaSeconds / 60, etaSeconds % 60);
+  line += buffer;
+  if (final) {
+    line += "\n";
   }
-  
-  cerr.flush();
+  // stderr is unbuffered, so this is one write
+  fwrite(line.data(), 1, line.size(), stderr);
 }
@@ -0,0 +1,159 @@
+#include <cstring>
+#include <iostream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "rawImage.h"
+
+constexpr size_t headerAlign = 64;
+
+const char *formatExtension(ImageFormat format) {
+  switch (format) {
+  case ImageFormat::PGM:
+    return ".pgm";
+  case ImageFormat::PPM:
+    return ".ppm";
+  case ImageFormat::NPY:
+  case ImageFormat::NPY_BATCH:
+    return ".npy";
+  case ImageFormat::PNG:
+  default:
+    return ".png";
+  }
+}
+
+// copy pixels into out, converting to greyscale for a single channel
+static void copyPixels(unsigned char *out, const unsigned char *rgb, int width,
+                       int height, int stride, int channels) {
+  if (channels == 3 && stride == 3*width) {
+    memcpy(out, rgb, (size_t)stride*height);
+    return;
+  }
+  for (int y = 0; y < height; ++y) {
+    const unsigned char *row = rgb + (size_t)y*stride;
+    if (channels == 3) {
+      memcpy(out, row, 3*width);
+      out += 3*width;
+      continue;
+    }
+    for (int x = 0; x < width; ++x) {
+      // BT.601 weights in 8.8 fixed point; exact when r == g == b
+      *out++ = (77*row[3*x] + 150*row[3*x + 1] + 29*row[3*x + 2]) >> 8;
+    }
+  }
+}
+
+// NumPy format 1.0 header: magic, version, u16 length, then a dict padded
+// with spaces and a newline to the alignment boundary
+static std::string npyHeader(const std::string &shape) {
+  std::string dict = "{'descr': '|u1', 'fortran_order': False, 'shape': " + shape + ", }";
+  std::string header("\x93NUMPY\x01\x00", 8);
+  const size_t total = (10 + dict.size() + 1 + headerAlign - 1) / headerAlign * headerAlign;
+  dict.append(total - 10 - dict.size() - 1, ' ');
+  dict += '\n';
+  header += (char)(dict.size() & 0xff);
+  header += (char)(dict.size() >> 8);
+  return header + dict;
+}
+
+static std::string npyShape(int64_t count, int width, int height, int channels) {
+  std::string shape = "(";
+  if (count >= 0) {
+    // fixed width so the header size does not change when patched
+    char buffer[24];
+    std::snprintf(buffer, sizeof(buffer), "%12lld, ", (long long)count);
+    shape += buffer;
+  }
+  shape += std::to_string(height) + ", " + std::to_string(width);
+  if (channels == 3) {
+    shape += ", 3";
+  }
+  return shape + ")";
+}
+
+void encodeRawImage(std::vector<unsigned char> &out, ImageFormat format,
+                    const unsigned char *rgb, int width, int height, int stride,
+                    int channels) {
+  std::string header;
+  switch (format) {
+  case ImageFormat::PGM:
+  case ImageFormat::PPM: {
+    channels = format == ImageFormat::PGM ? 1 : 3;
+    // pad with a comment so the raster starts on the alignment boundary
+    const std::string size = std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    header = format == ImageFormat::PGM ? "P5\n#" : "P6\n#";
+    header.append(headerAlign - header.size() - 1 - size.size(), ' ');
+    header += "\n" + size;
+    break;
+  }
+  case ImageFormat::NPY:
+  case ImageFormat::NPY_BATCH:
+  default:
+    header = npyHeader(npyShape(-1, width, height, channels));
+    break;
+  }
+
+  const size_t start = out.size();
+  out.resize(start + header.size() + (size_t)channels*width*height);
+  memcpy(&out[start], header.data(), header.size());
+  copyPixels(&out[start + header.size()], rgb, width, height, stride, channels);
+}
+
+NpyBatchWriter::NpyBatchWriter(const std::string &path, int width, int height, int channels)
+  : fPath(path), fFd(-1), fWidth(width), fHeight(height), fChannels(channels), fCount(0),
+    fDataStart(0), fErrors(0) {
+  fFd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fFd < 0) {
+    std::cerr << "ERROR::NPY::OPEN_FAILED: '" << path << "'; " << strerror(errno) << std::endl;
+    return;
+  }
+  fFrame.resize((size_t)fChannels*fWidth*fHeight);
+  WriteHeader();
+}
+
+void NpyBatchWriter::WriteHeader() {
+  const std::string header = npyHeader(npyShape(fCount, fWidth, fHeight, fChannels));
+  if (pwrite(fFd, header.data(), header.size(), 0) != (ssize_t)header.size()) {
+    std::cerr << "ERROR::NPY::WRITE_FAILED: '" << fPath << "'; " << strerror(errno) << std::endl;
+    ++fErrors;
+  }
+  if (fCount == 0) {
+    fDataStart = header.size();
+    lseek(fFd, fDataStart, SEEK_SET);
+  }
+}
+
+int64_t NpyBatchWriter::Append(const unsigned char *rgb, int stride) {
+  if (fFd < 0) {
+    ++fErrors;
+    return -1;
+  }
+  copyPixels(fFrame.data(), rgb, fWidth, fHeight, stride, fChannels);
+  size_t done = 0;
+  while (done < fFrame.size()) {
+    ssize_t n = write(fFd, fFrame.data() + done, fFrame.size() - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "ERROR::NPY::WRITE_FAILED: '" << fPath << "'; " << strerror(errno) << std::endl;
+      ++fErrors;
+      // drop any partial image so later rows stay aligned
+      lseek(fFd, fDataStart + fCount*(off_t)fFrame.size(), SEEK_SET);
+      return -1;
+    }
+    done += n;
+  }
+  return fCount++;
+}
+
+void NpyBatchWriter::Close() {
+  if (fFd < 0) {
+    return;
+  }
+  WriteHeader();
+  close(fFd);
+  fFd = -1;
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+
+#include "renderTarget.h"
+
+RenderTarget::RenderTarget(int width, int height)
+  : fFBO(0), fTexture(0), fWidth(width), fHeight(height), fComplete(false) {
+  // colour texture, so later passes can sample the frame
+  glGenTextures(1, &fTexture);
+  glBindTexture(GL_TEXTURE_2D, fTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, fWidth, fHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffers(1, &fFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, fFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fTexture, 0);
+  fComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  if (!fComplete) {
+    std::cerr << "ERROR::RENDER_TARGET::INCOMPLETE_FRAMEBUFFER: " << fWidth << "x" << fHeight << std::endl;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderTarget::Destroy() {
+  if (fFBO) {
+    glDeleteFramebuffers(1, &fFBO);
+    glDeleteTextures(1, &fTexture);
+    fFBO = 0;
+    fTexture = 0;
+  }
+}
+
+void RenderTarget::Bind() {
+  glBindFramebuffer(GL_FRAMEBUFFER, fFBO);
+  glViewport(0, 0, fWidth, fHeight);
+}
+
+void RenderTarget::ReadPixels(std::vector<unsigned char> &out) {
+  out.resize(3*fWidth*fHeight);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fFBO);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, fWidth, fHeight, GL_RGB, GL_UNSIGNED_BYTE, out.data());
+}
+
+void RenderTarget::BlitToWindow(int windowWidth, int windowHeight, bool flipY) {
+  // largest rectangle with our aspect ratio, centred in the window
+  int width = windowWidth;
+  int height = (long)windowWidth * fHeight / fWidth;
+  if (height > windowHeight) {
+    height = windowHeight;
+    width = (long)windowHeight * fWidth / fHeight;
+  }
+  const int x0 = (windowWidth - width) / 2;
+  const int y0 = (windowHeight - height) / 2;
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glViewport(0, 0, windowWidth, windowHeight);
+  glClearColor(0, 0, 0, 1);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fFBO);
+  if (flipY) {
+    glBlitFramebuffer(0, 0, fWidth, fHeight, x0, y0 + height, x0 + width, y0,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  } else {
+    glBlitFramebuffer(0, 0, fWidth, fHeight, x0, y0, x0 + width, y0 + height,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  }
+}
@@ -2,12 +2,140 @@
 #include <sstream>
 #include <iostream>
 #include <errno.h>
+#include <unistd.h>
 #include <cstring>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
 
 #include "shaderClass.h"
 
 int compileShader1(GLenum shaderType, GLuint &shader, int infoLogSize, char *infoLog, const char **src);
 
+/* Program binary cache -- GL 4.1 / ARB_get_program_binary, which our
+   GL 3.3 loader does not cover, so the entry points are looked up here */
+
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+static PFNGLGETPROGRAMBINARYPROC glGetProgramBinary = nullptr;
+static PFNGLPROGRAMBINARYPROC glProgramBinary = nullptr;
+static PFNGLPROGRAMPARAMETERIPROC glProgramParameteri = nullptr;
+
+static const char binaryMagic[8] = {'R', 'G', 'S', 'H', 'B', 'I', 'N', '1'};
+
+// empty when the cache is off
+static std::string binaryCacheDir;
+// identifies the driver, as binaries are only valid for the one that made them
+static std::string driverString;
+
+static uint64_t fnv1a64(uint64_t hash, const std::string &data) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static std::string binaryCachePath(const std::string &vertexSrc, const std::string &fragSrc) {
+  uint64_t hash = 14695981039346656037ull;
+  hash = fnv1a64(hash, vertexSrc);
+  hash = fnv1a64(hash, std::string(1, '\0'));
+  hash = fnv1a64(hash, fragSrc);
+  hash = fnv1a64(hash, std::string(1, '\0'));
+  hash = fnv1a64(hash, driverString);
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+  return (std::filesystem::path(binaryCacheDir) / name).string();
+}
+
+bool Shader::enableBinaryCache(const std::string &dir, GLADloadproc load) {
+  glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+  glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+  glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+  GLint numFormats = 0;
+  if (glGetProgramBinary && glProgramBinary && glProgramParameteri) {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+  }
+  if (numFormats <= 0) {
+    std::cerr << "program binaries unsupported by this driver; shader cache disabled" << std::endl;
+    return false;
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    std::cerr << "ERROR::SHADER::CACHE_DIR: '" << dir << "'; " << ec.message() << std::endl;
+    return false;
+  }
+  binaryCacheDir = dir;
+  driverString = std::string((const char*)glGetString(GL_VENDOR)) + "|" +
+    (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+  return true;
+}
+
+bool Shader::loadBinary(const std::string &cachePath) {
+  std::ifstream file(cachePath, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  char magic[sizeof(binaryMagic)];
+  GLenum format;
+  file.read(magic, sizeof(magic));
+  file.read((char*)&format, sizeof(format));
+  if (!file || memcmp(magic, binaryMagic, sizeof(magic))) {
+    return false;
+  }
+  std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (binary.empty()) {
+    return false;
+  }
+
+  ID = glCreateProgram();
+  glProgramBinary(ID, format, binary.data(), binary.size());
+  GLint success;
+  glGetProgramiv(ID, GL_LINK_STATUS, &success);
+  if (!success) {
+    // stale binary, e.g. after a driver update; compile instead
+    glDeleteProgram(ID);
+    ID = 0;
+    return false;
+  }
+  return true;
+}
+
+void Shader::saveBinary(const std::string &cachePath) const {
+  GLint length = 0;
+  glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<char> binary(length);
+  GLenum format;
+  glGetProgramBinary(ID, length, &length, &format, binary.data());
+
+  // write then rename, so concurrent workers never load a partial file
+  const std::string tmpPath = cachePath + ".tmp" + std::to_string(getpid());
+  std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+  file.write(binaryMagic, sizeof(binaryMagic));
+  file.write((const char*)&format, sizeof(format));
+  file.write(binary.data(), length);
+  file.close();
+  std::error_code ec;
+  if (file) {
+    std::filesystem::rename(tmpPath, cachePath, ec);
+  }
+  if (!file || ec) {
+    std::filesystem::remove(tmpPath, ec);
+    std::cerr << "ERROR::SHADER::CACHE_WRITE_FAILED: '" << cachePath << "'" << std::endl;
+  }
+}
+
 Shader::Shader(const char *vertexShaderPath, const char *fragShaderPath) {
   // declare variables to store shader source code
   std::string vertexSrc;
@@ -43,6 +171,25 @@ Shader::Shader(const char *vertexShaderPath, const char *fragShaderPath) {
     throw e;
   }
 
+  build(vertexSrc, fragSrc, vertexShaderPath, fragShaderPath);
+}
+
+Shader::Shader(FromSourceTag, const std::string &vertexSrc, const std::string &fragSrc,
+               const std::string &name) {
+  build(vertexSrc, fragSrc, name + " (vertex)", name + " (fragment)");
+}
+
+void Shader::build(const std::string &vertexSrc, const std::string &fragSrc,
+                   const std::string &vertexName, const std::string &fragName) {
+  // try a previously linked binary of the same sources first
+  std::string cachePath;
+  if (!binaryCacheDir.empty()) {
+    cachePath = binaryCachePath(vertexSrc, fragSrc);
+    if (loadBinary(cachePath)) {
+      return;
+    }
+  }
+
   // convert std::string source to GL-compatible const char*
   // stream -> string -> const char* is "safer" than stream -> char*
   const char* glVertexSrc = vertexSrc.c_str();
@@ -58,19 +205,22 @@ Shader::Shader(const char *vertexShaderPath, const char *fragShaderPath) {
   int success = compileShader1(GL_VERTEX_SHADER, vertShaderID, sizeof(infoLog), infoLog, &glVertexSrc);
   if (!success) {
     // TODO: maybe use a throw here? Can then handle it elsewhere if desired
-    std::cerr << "ERROR::SHADER::VERTEX_SHADER::COMPILATION_FAILED\nFrom shader src file '" << vertexShaderPath << "'; Info Log below:\n" << infoLog << std::endl;
+    std::cerr << "ERROR::SHADER::VERTEX_SHADER::COMPILATION_FAILED\nFrom shader src file '" << vertexName << "'; Info Log below:\n" << infoLog << std::endl;
     return;
   }
   //   fragment:
   success = compileShader1(GL_FRAGMENT_SHADER, fragShaderID, sizeof(infoLog), infoLog, &glFragSrc);
   if (!success) {
   // TODO: maybe use a throw here? Can then handle it elsewhere if desired
-    std::cerr << "ERROR::SHADER::FRAG_SHADER::COMPILATION_FAILED\nFrom shader src file '" << fragShaderPath << "'; Info Log below:\n" << infoLog << std::endl;
+    std::cerr << "ERROR::SHADER::FRAG_SHADER::COMPILATION_FAILED\nFrom shader src file '" << fragName << "'; Info Log below:\n" << infoLog << std::endl;
     return;
   }
 
   // construct shader program
   ID = glCreateProgram();
+  if (!cachePath.empty()) {
+    glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
   glAttachShader(ID, vertShaderID);
   glAttachShader(ID, fragShaderID);
   glLinkProgram(ID);
@@ -79,7 +229,7 @@ Shader::Shader(const char *vertexShaderPath, const char *fragShaderPath) {
   glGetProgramiv(ID, GL_LINK_STATUS, &success);
   if (!success) {
     glGetProgramInfoLog(ID, sizeof(infoLog), 0, infoLog);
-    std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\nFrom shader src files:\n  - '" << vertexShaderPath << "'\n  - '" << fragShaderPath << "'\nInfo Log below:\n" << infoLog << std::endl;
+    std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\nFrom shader src files:\n  - '" << vertexName << "'\n  - '" << fragName << "'\nInfo Log below:\n" << infoLog << std::endl;
     ID = 0;
     return;
   }
@@ -87,6 +237,10 @@ Shader::Shader(const char *vertexShaderPath, const char *fragShaderPath) {
   // delete intermediate shaders
   glDeleteShader(vertShaderID);
   glDeleteShader(fragShaderID);
+
+  if (!cachePath.empty()) {
+    saveBinary(cachePath);
+  }
 }
 
 inline GLuint Shader::getUniformLocation(const std::string &name) const {
@@ -102,6 +256,10 @@ void Shader::setUniform(const std::string &name, int value) const {
   glUniform1i(getUniformLocation(name), value);
 }
 
+void Shader::setUniform(const std::string &name, unsigned value) const {
+  glUniform1ui(getUniformLocation(name), value);
+}
+
 void Shader::setUniform(const std::string &name, float value) const {
   glUniform1f(getUniformLocation(name), value);
 }
@@ -119,6 +277,10 @@ void Shader::setUniform(const std::string &name, float v1, float v2, float v3) c
   glUniform3f(getUniformLocation(name), v1, v2, v3);
 }
 
+void Shader::setUniform(const std::string &name, const float matrix[4]) const {
+  glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, matrix);
+}
+
 void Shader::use() {
   glUseProgram(ID);
 }
@@ -0,0 +1,51 @@
+#include "shaderVariants.h"
+
+ShaderVariants::ShaderVariants(const std::string &vertexSrc, const std::string &fragSrc,
+                               const std::vector<std::string> &features, const std::string &name)
+  : fVertexSrc(vertexSrc), fFragSrc(fragSrc), fFeatures(features), fName(name) {}
+
+std::string ShaderVariants::Specialize(const std::string &src, unsigned features) const {
+  std::string defines;
+  for (size_t i = 0; i < fFeatures.size(); ++i) {
+    if (features & (1u << i)) {
+      defines += "#define " + fFeatures[i] + "\n";
+    }
+  }
+  // #version has to stay the first line
+  size_t start = 0;
+  if (src.compare(0, 8, "#version") == 0) {
+    const size_t newline = src.find('\n');
+    start = newline == std::string::npos ? src.size() : newline + 1;
+  }
+  std::string out = src.substr(0, start);
+  if (start == src.size() && start > 0 && src.back() != '\n') {
+    out += '\n';
+  }
+  return out + defines + src.substr(start);
+}
+
+Shader &ShaderVariants::Get(unsigned features) {
+  auto found = fVariants.find(features);
+  if (found != fVariants.end()) {
+    return *found->second;
+  }
+
+  std::string name = fName;
+  for (size_t i = 0; i < fFeatures.size(); ++i) {
+    if (features & (1u << i)) {
+      name += "+" + fFeatures[i];
+    }
+  }
+  auto shader = std::make_unique<Shader>(Shader::FromSource, Specialize(fVertexSrc, features),
+                                         Specialize(fFragSrc, features), name);
+  Shader &result = *shader;
+  fVariants[features] = std::move(shader);
+  return result;
+}
+
+void ShaderVariants::Destroy() {
+  for (auto &variant : fVariants) {
+    glDeleteProgram(variant.second->ID);
+  }
+  fVariants.clear();
+}
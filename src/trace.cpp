@@ -0,0 +1,73 @@
+#ifdef ENABLE_TRACING
+
+#include <cstdio>
+#include <iostream>
+
+#include "trace.h"
+
+Tracer &Tracer::Get() {
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::Enable(const std::string &path, size_t capacity) {
+  if (Enabled()) {
+    return;
+  }
+  // round up to a power of two so slots can be found with a mask
+  size_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  fEvents.assign(size, Event{nullptr, 0, 0, 0});
+  fPath = path;
+  fNext = 0;
+  fEnabled.store(true, std::memory_order_release);
+}
+
+void Tracer::Record(const char *name, uint64_t startNs, uint64_t endNs) {
+  static std::atomic<uint32_t> nextThread(0);
+  thread_local uint32_t thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+  // once full, the oldest spans are overwritten
+  const uint64_t slot = fNext.fetch_add(1, std::memory_order_relaxed) & (fEvents.size() - 1);
+  fEvents[slot] = Event{name, startNs, endNs, thread};
+}
+
+void Tracer::Dump() {
+  if (!fEnabled.exchange(false)) {
+    return;
+  }
+  FILE *file = fopen(fPath.c_str(), "w");
+  if (!file) {
+    std::cerr << "ERROR::TRACE::FAILED_TO_OPEN: '" << fPath << "'" << std::endl;
+    return;
+  }
+
+  const uint64_t recorded = fNext.load();
+  const uint64_t count = recorded < fEvents.size() ? recorded : fEvents.size();
+  // times are relative to the earliest span kept
+  uint64_t origin = UINT64_MAX;
+  for (uint64_t i = 0; i < count; ++i) {
+    if (fEvents[i].name && fEvents[i].startNs < origin) {
+      origin = fEvents[i].startNs;
+    }
+  }
+
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+  bool first = true;
+  for (uint64_t i = 0; i < count; ++i) {
+    const Event &event = fEvents[(recorded - count + i) & (fEvents.size() - 1)];
+    if (!event.name) {
+      continue;
+    }
+    fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            first ? "" : ",\n", event.name, event.thread,
+            (event.startNs - origin) / 1e3, (event.endNs - event.startNs) / 1e3);
+    first = false;
+  }
+  fputs("\n]}\n", file);
+  fclose(file);
+  std::cerr << "wrote " << count << " trace events to '" << fPath << "'" << std::endl;
+}
+
+#endif // ENABLE_TRACING
@@ -1,17 +1,18 @@
 #include <algorithm>
-#include <iostream>
 
 #include "triangle.h"
 #include "utils.h"
 
-const int maxDistancePlaces = MAX_DISTANCE_PLACES;
-const int maxDistancePower = pow(10.0, maxDistancePlaces);
+// one bounds entry per entry of the sin/cos table, so the bounds of an
+// angle are those of exactly the rotation the shader draws
+constexpr int boundsStepsPerDegree = TRIG_STEPS_PER_DEGREE;
+constexpr int boundsSteps = 360*boundsStepsPerDegree;
 
 // constexpr int perCoord = 2;
 // constexpr int arrayLength = 3*perCoord;
 
 Triangle::Triangle(const float vertices[6])
-  : fMaxDistance(0), fMaxDistanceMod(0) {
+  : fBoundsMargin(0), fBufferFloats(0), fTriangleOnly(true) {
   // copy vertices to internal
   std::copy(&vertices[0], &vertices[1]+1, &fVertices[0]);
   std::copy(&vertices[2], &vertices[3]+1, &fVertices[3]);
@@ -39,38 +40,123 @@ Triangle::Triangle(const float vertices[6])
   // y coords
   fVertices[1] -= fCOM[1];
   fVertices[4] -= fCOM[1];
-  fVertices[6] -= fCOM[1];
+  fVertices[7] -= fCOM[1];
 
-  // construct OGL structures
+  // construct OGL structures; the buffer starts out holding just the
+  // triangle, with a negative shade marking its vertices for the shader
+  for (int i = 0; i < 9; i += 3) {
+    fBatch.insert(fBatch.end(), {fVertices[i], fVertices[i+1], fVertices[i+2], -1.0f});
+  }
+  fBufferFloats = fBatch.size();
   glGenBuffers(1, &VBO);
   glGenVertexArrays(1, &VAO);
   glBindVertexArray(VAO);
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(fVertices), fVertices, GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0);
+  glBufferData(GL_ARRAY_BUFFER, fBatch.size()*sizeof(float), fBatch.data(), GL_DYNAMIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)0);
   glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 4*sizeof(float), (void*)(3*sizeof(float)));
+  glEnableVertexAttribArray(1);
+
+  BuildBoundsTable();
+}
 
-  // determine max distance triangle can be displaced
-  for (int i = 0; i < 9; i+=3) {
-    float distance = sqrt(fVertices[i]*fVertices[i] + fVertices[i+1]*fVertices[i+1]);
-    if (distance > fMaxDistance) {
-      fMaxDistance = distance;
+// tabulate the rotated bounding box at every angle step so that the legal
+// displacement range for a sample costs a lookup rather than trig
+void Triangle::BuildBoundsTable() {
+  // angles are rounded to the same step here and in sinCosDegrees, so the
+  // margin only has to absorb float rounding
+  fBoundsMargin = 1e-6;
+
+  fBounds.resize(4*boundsSteps);
+  for (int step = 0; step < boundsSteps; ++step) {
+    float s, c;
+    sinCosDegrees((float)step / boundsStepsPerDegree, s, c);
+    float *bounds = &fBounds[4*step];
+    bounds[0] = bounds[2] = INFINITY;
+    bounds[1] = bounds[3] = -INFINITY;
+    for (int i = 0; i < 9; i += 3) {
+      // same rotation as the vertex shader
+      const float x = c*fVertices[i] + s*fVertices[i+1];
+      const float y = -s*fVertices[i] + c*fVertices[i+1];
+      bounds[0] = std::min(bounds[0], x);
+      bounds[1] = std::max(bounds[1], x);
+      bounds[2] = std::min(bounds[2], y);
+      bounds[3] = std::max(bounds[3], y);
     }
   }
-  fMaxDistanceMod = (float)(1.0 - floorTo(fMaxDistance, maxDistancePlaces)) * maxDistancePower;
-  std::cerr << "Max Distance: " << fMaxDistance << "\nMax distance mod: " << fMaxDistanceMod << std::endl;
 }
 
-void Triangle::GenerateDisplacements(float &outXDisp, float &outYDisp, float multiplier) {
-  // generate a random float between 0 and fMaxDistance via fMaxDistanceMod
-  float rDisp = (float)(rand() % fMaxDistanceMod) / maxDistancePower * multiplier;
-  float thetaDisp = ((rand() % 36000) / 100.) * M_PI/180.;
-  // convert polars to cartesian
-  outXDisp = rDisp * cos(thetaDisp);
-  outYDisp = rDisp * sin(thetaDisp);
+// get the (padded) bounding box of the triangle rotated by angle degrees
+void Triangle::GetBounds(float angle, float outBounds[4]) const {
+  int step = (int)std::lround(angle * boundsStepsPerDegree) % boundsSteps;
+  if (step < 0) {
+    step += boundsSteps;
+  }
+  const float *bounds = &fBounds[4*step];
+  outBounds[0] = bounds[0] - fBoundsMargin;
+  outBounds[1] = bounds[1] + fBoundsMargin;
+  outBounds[2] = bounds[2] - fBoundsMargin;
+  outBounds[3] = bounds[3] + fBoundsMargin;
+}
+
+void Triangle::GenerateDisplacements(float angle, float &outXDisp, float &outYDisp, float multiplier) {
+  // the triangle stays in frame for any displacement keeping its rotated
+  // bounding box inside [-1, 1]
+  float bounds[4];
+  GetBounds(angle, bounds);
+  outXDisp = randFloat(-1 - bounds[0], 1 - bounds[1]) * multiplier;
+  outYDisp = randFloat(-1 - bounds[2], 1 - bounds[3]) * multiplier;
+}
+
+// add a distractor to the batch as a fan of triangles
+void Triangle::AppendPolygon(const Distractor &distractor) {
+  const float step = 360.0f / distractor.sides;
+  auto corner = [&](int i) {
+    float s, c;
+    sinCosDegrees(distractor.angle + i*step, s, c);
+    fBatch.insert(fBatch.end(), {distractor.x + distractor.radius*c,
+                                 distractor.y + distractor.radius*s,
+                                 0.0f, distractor.shade});
+  };
+  for (int i = 1; i + 1 < distractor.sides; ++i) {
+    corner(0);
+    corner(i);
+    corner(i + 1);
+  }
 }
 
-void Triangle::Draw() {
+void Triangle::Draw(const std::vector<Distractor> &distractors) {
   glBindVertexArray(VAO);
-  glDrawArrays(GL_TRIANGLES, 0, 3);
+  if (distractors.empty() && fTriangleOnly) {
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    return;
+  }
+
+  // later triangles cover earlier ones, so the draw order is the depth
+  // order: distractors behind, the triangle, then those in front
+  fBatch.clear();
+  for (const Distractor &distractor : distractors) {
+    if (!distractor.front) {
+      AppendPolygon(distractor);
+    }
+  }
+  for (int i = 0; i < 9; i += 3) {
+    fBatch.insert(fBatch.end(), {fVertices[i], fVertices[i+1], fVertices[i+2], -1.0f});
+  }
+  for (const Distractor &distractor : distractors) {
+    if (distractor.front) {
+      AppendPolygon(distractor);
+    }
+  }
+  fTriangleOnly = distractors.empty();
+
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  if (fBatch.size() > fBufferFloats) {
+    fBufferFloats = fBatch.size();
+    glBufferData(GL_ARRAY_BUFFER, fBatch.size()*sizeof(float), fBatch.data(), GL_DYNAMIC_DRAW);
+  } else {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, fBatch.size()*sizeof(float), fBatch.data());
+  }
+  glDrawArrays(GL_TRIANGLES, 0, fBatch.size()/4);
 }
@@ -1,6 +1,11 @@
+#define _USE_MATH_DEFINES
 #include <cmath>
+#include <vector>
 #include "utils.h"
 
+constexpr int trigStepsPerDegree = TRIG_STEPS_PER_DEGREE;
+constexpr int trigSteps = 360*trigStepsPerDegree;
+
 // round to a certain number of decimal places
 float floorTo(float value, int places) {
   float power = pow(10.0, places);
@@ -17,3 +22,39 @@ float randFloat() {
 float randFloat(const float min, const float max) {
   return min + randFloat()*(max - min);
 }
+
+// interleaved sin and cos of every step of a full turn
+struct TrigTable {
+  std::vector<float> entries;
+  TrigTable() : entries(2*trigSteps) {
+    for (int step = 0; step < trigSteps; ++step) {
+      const double theta = (double)step / trigStepsPerDegree * M_PI/180.;
+      entries[2*step] = sin(theta);
+      entries[2*step + 1] = cos(theta);
+    }
+  }
+};
+
+void sinCosDegrees(float angle, float &outSin, float &outCos) {
+  static const TrigTable table;
+  int step = (int)std::lround(angle * trigStepsPerDegree) % trigSteps;
+  if (step < 0) {
+    step += trigSteps;
+  }
+  outSin = table.entries[2*step];
+  outCos = table.entries[2*step + 1];
+}
+
+RateLimiter::RateLimiter(double intervalMs)
+  : fInterval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(intervalMs))),
+    fNext(std::chrono::steady_clock::time_point::min()) {}
+
+bool RateLimiter::Ready() {
+  const auto now = std::chrono::steady_clock::now();
+  if (now < fNext) {
+    return false;
+  }
+  fNext = now + fInterval;
+  return true;
+}